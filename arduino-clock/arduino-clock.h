@@ -3,15 +3,38 @@
 
 ////////// Hardware configuration //////////
 //Include the config file that matches your hardware setup. If needed, duplicate an existing one.
+//(A build can also name one as CONFIG_FILE, as the host build does – see host/README.md.)
 
+#ifdef CONFIG_FILE
+#include CONFIG_FILE
+#else
 #include "configs/led7segHT-avr.h"
+#endif
 
 ////////////////////////////////////////////
 
 
 void setup();
 void loop();
-void ctrlEvt(byte ctrl, byte evt, byte evtLast, bool velocity=0);
+void taskWake(byte t);
+bool taskRun(bool bus);
+void taskIdle();
+bool idleReady();
+void idleSleep();
+unsigned long taskInput(unsigned long now);
+unsigned long taskTimer(unsigned long now);
+unsigned long taskRTC(unsigned long now);
+unsigned long taskDisplay(unsigned long now);
+unsigned long taskPixel(unsigned long now);
+unsigned long pixelShow();
+unsigned long taskPersist(unsigned long now);
+unsigned long taskTelemetry(unsigned long now);
+unsigned long taskProfiler(unsigned long now);
+unsigned long taskRTCPoll(unsigned long now);
+unsigned long taskLight(unsigned long now);
+void busTask(void *arg);
+void busHold(bool on);
+void ctrlEvt(byte ctrl, byte evt, byte evtLast, word steps=1);
 // void fnScroll(byte dir);
 // void fnOptScroll(byte dir);
 // void goToFn(byte thefn, byte thefnPg=0);
@@ -38,27 +61,49 @@ void checkRTC(bool force);
 // bool isTimeInRange(word tstart, word tend, word ttest);
 // bool isDayInRange(byte dstart, byte dend, byte dtest);
 void millisCheckDrift();
-void millisApplyDrift();
+void millisSetRate(long rate);
+void millisAdvance(unsigned long el);
 void millisReset();
-unsigned long ms();
-void timerStart();
-void timerStop();
-void timerClear();
-// void timerLap();
+unsigned long long msAtMillis(unsigned long m);
+unsigned long long ms();
+unsigned long long msAtMicros(unsigned long us);
+void timerStart(byte c, unsigned long long at);
+void timerStop(byte c, unsigned long long at);
+void timerClear(byte c);
+void timerSetDur(byte c, unsigned long dur);
+void timerAdjust(byte c, bool up, word steps);
+void timerShow(byte c);
+unsigned long rtcStamp();
+void timerSnapshot();
+void timerRestore();
+void timerPersistCycle();
+void timerLap(unsigned long long at);
+void timerLapPage();
+unsigned long long timerLapValue(byte back);
 // void timerRunoutToggle();
+void timerRunout(byte c);
 void cycleTimer();
 // void timerSleepSwitch(bool on);
 byte getTimerState();
 void setTimerState(char pos, bool val);
 // void tempDisplay(int i0, int i1=0, int i2=0, int i3=0);
+void fmtStep(byte k, byte n, bool up);
+void fmtUpdate(unsigned long long td);
 void updateDisplay();
 // void calcSun();
 // void displaySun(byte which, int d, int tod);
 // void displayWeather(byte which);
 void initOutputs();
-// void signalStart(byte sigFn, byte sigDur);
-// void signalStop();
-// void cycleSignal();
+bool sigClaim(byte from, byte to);
+bool sigTake(byte c);
+void sigArm();
+void signalOn(byte c);
+void signalOff();
+void signalStart(unsigned long long at, bool quick);
+void signalStop();
+bool signalBusy();
+void cycleSignal();
+void signalSwitch();
 // word getSignalPitch();
 // word getHz(byte note);
 // byte getSignalOutput();
@@ -1,6 +1,6 @@
 //Forked from https://github.com/clockspot/arduino-clock
 
-#include <arduino.h>
+#include <Arduino.h>
 #include "arduino-clock.h"
 
 ////////// Software version //////////
@@ -12,31 +12,358 @@ const bool vDev = 1;
 ////////// Includes //////////
 
 // These modules are used per the available hardware and features enabled in the config file.
-// The disp and rtc options are mutually exclusive and define the same functions.
+// The disp and rtc options are mutually exclusive and define the same functions. (The disp options share one frame layer – see dispFrame.h.)
 #include "dispMAX7219.h" //active if DISPLAY_MAX7219 is defined in config - for a SPI MAX7219 8x8 LED array
 #include "dispHT16K33.h" //active if DISPLAY_HT16K33 is defined in config - for an I2C 7-segment LED display
 #include "rtcDS3231.h" //active if RTC_DS3231 is defined in config – for an I2C DS3231 RTC module
 #include "rtcMillis.h" //active if RTC_MILLIS is defined in config – for a fake RTC based on millis
+#include "timebase32k.h" //active if TIMEBASE_32K is defined in config – for a chrono timebase counted from the DS3231's 32kHz output
 #include "input.h" //for Sel/Alt/Up/Dn - supports buttons, rotary control, and Nano 33 IoT IMU
+#include "persist.h" //active if PERSIST_STATE is defined in config – to restore timer state after a power cut
+#include "telemetry.h" //active if TELEMETRY_LEVEL is defined in config – to stream timer events over Serial
+#include "lightVEML7700.h" //active if LIGHTSENSOR_VEML7700 is defined in config – for an I2C VEML7700 ambient light sensor
+#include "i2cBus.h" //active if any I2C device is in use – so they take turns on the bus, one transaction per task pass
+#include "profiler.h" //active if ENABLE_PROFILER is defined in config – to time each task, and dump the results over telemetry
+
+#ifdef __AVR__
+  #include <avr/sleep.h> //to idle between tasks
+#endif
 
 #ifdef ENABLE_NEOPIXEL
   #include <Adafruit_NeoPixel.h>
   #define NUMPIXELS 1
   Adafruit_NeoPixel pixels(NUMPIXELS, PIN_NEOPIXEL, NEO_GRB + NEO_KHZ800);
+  uint32_t pixelColor = 0xFFFFFF; //what the pixel should show, 0xRRGGBB – see pixelShow
+  uint32_t pixelShown = 0x1000000; //what it last showed – never a valid colour to start, so the first is shown
+  #ifndef PIXEL_DEFER
+    #ifdef ESP32
+      #define PIXEL_DEFER 0 //show() sends by RMT peripheral, with interrupts on, so it needn't wait
+    #else
+      #define PIXEL_DEFER 1 //show() bit-bangs with interrupts off, which would hold up input edges and millis() – so wait until we're not timing
+    #endif
+  #endif
 #endif
 
 
 ////////// Variables and storage //////////
 
-byte timerState = 0b10; //bit 0 is stop/run, bit 1 is down/up, bit 2 is runout repeat / short signal, bit 3 is runout chrono, bit 4 is lap display
-unsigned long timerTime = 0; //timestamp of timer target / chrono origin (while running) or duration (while stopped)
-//poop unsigned long timerLapTime = 0; 
+#ifndef TIMER_CHANNELS
+#define TIMER_CHANNELS 1 //how many independent timers, up to 16. If more than 1, Sel/Alt/Up/Dn each start/stop their own (see ctrlEvt).
+#endif
+#if TIMER_CHANNELS>16
+#error "TIMER_CHANNELS can be at most 16"
+#endif
+//The timers are a table, stored as an array per field, indexed by channel
+byte timerState[TIMER_CHANNELS]; //bit 1 is down/up, bit 2 is runout repeat / short signal, bit 3 is runout chrono, bit 4 is lap display, bit 5 is split (rather than lap time) in lap display. Set up in setup.
+unsigned long long timerTime[TIMER_CHANNELS]; //ms() timestamp of timer target / chrono origin (while running) or duration (while stopped)
+#ifndef TIMER_COUNTDOWN
+#define TIMER_COUNTDOWN 0 //sec – if nonzero, the timers count down from this (to start with, and whenever cleared), rather than up from zero
+#endif
+#ifndef TIMER_RUNOUT
+#define TIMER_RUNOUT 0 //what a countdown does when it reaches zero, per timerState: 0 = stop, 4 = start over (with a short signal), 8 = carry on counting up
+#endif
+unsigned long timerDur[TIMER_CHANNELS]; //the duration (ms) each channel counts down from, when cleared – 0 to count up. Set up in setup.
+word timerRunning = 0; //bit per channel: stop/run – so cycleTimer can check all channels with one test
+word timerHeld = 0; //bit per channel: stopped with a duration (not cleared), for the stopwatch timeout
+bool timerDirty = 0; //set when timer state changes, so it will be checkpointed (if PERSIST_STATE – see timerPersistCycle)
+#if TIMER_CHANNELS>1
+byte timerCh = 0; //channel shown on the display
+unsigned long timerCycleLast = 0; //when the display last cycled to the next channel, per TIMER_CYCLE_DUR, millis()
+#else
+const byte timerCh = 0;
+#endif
+#ifndef LAP_COUNT
+#define LAP_COUNT 32 //how many laps to remember – must be a power of 2, or 0 to disable laps
+#endif
+#if TIMER_CHANNELS>1
+#undef LAP_COUNT
+#define LAP_COUNT 0 //Alt controls its own channel, so no laps
+#endif
+#if LAP_COUNT
+#define LAP_SHOW_DUR 3000 //ms – while running, how long a new lap is shown
+unsigned long lapDelta[LAP_COUNT]; //ring buffer of lap times, each as a delta from the previous lap's split (so up to 49 days)
+word lapTotal = 0; //laps recorded since start – the latest is lapDelta[(lapTotal-1)%LAP_COUNT]
+unsigned long long lapSplit = 0; //chrono duration at the latest lap
+byte lapView = 0; //during lap display, which lap, counting back from the latest (0)
+unsigned long long lapShowUntil = 0; //while running, ms() at which to go back from lap display to the running chrono
+#endif
 const byte millisCorrectionInterval = 30; //used to calibrate millis() to RTC for timer/chrono purposes
 unsigned long millisAtLastCheck = 0;
+bool fmtValid = 0; //when 0, the next fmtUpdate (see updateDisplay) will do a full conversion
+unsigned long long timerRenderNext = 0; //ms() at which the running timer's display will next visibly change, per updateDisplay
 
 #define SHOW_SERIAL 0 //for debugging
 
 
+////////// Task scheduler //////////
+
+// Rather than running everything back to back as fast as possible, loop() runs each task only when it's due.
+// Each task does its thing, and returns how long (ms) until it needs to run again – 0 to run again next loop.
+// Code that makes work for a task (e.g. updateDisplay) can bring it forward with taskWake.
+// Tasks run in table order, so input is handled first, and anything it causes is shown in the same pass.
+// On ESP32_DUAL_CORE, the tasks that talk to I2C (or other slow bus) hardware run in a separate bus task, pinned to core 0,
+// while loop() carries on with the rest on core 1 – so input and timing never wait on the bus (see busTask).
+#define TASK_INPUT_MS 1 //input scan period – this bounds input latency (edges are timestamped by interrupt regardless)
+#ifndef RTC_POLL_MS
+  #ifdef RTC_SQW_PIN
+    #define RTC_POLL_MS 10 //the tick is timestamped by interrupt (see rtcTakeSnap), so this only delays the display update a little
+  #else
+    #define RTC_POLL_MS 1 //each second starts when we first see it, so see it promptly
+  #endif
+#endif
+#define SIGNAL_CYCLE_MS 10 //how often taskTimer runs while a countdown signal is going, to keep its beeps/pulses on time
+#define DISPLAY_CYCLE_MS 50 //how often cycleDisplay runs when nothing has changed, to keep blinks and brightness going
+#define TASK_IDLE_MS 100 //how often tasks with nothing scheduled check in anyway
+struct Task {
+  unsigned long (*run)(unsigned long now); //does the work, and returns ms until due again
+  unsigned long due; //millis() when next due – only written by taskRun, on the task's own core
+  bool bus; //whether it talks to bus hardware – if ESP32_DUAL_CORE, it runs in the bus task
+  volatile byte woken; //set by taskWake, from anywhere (the other core, or an ISR) – so a wake can't be lost under taskRun's write to due
+};
+Task tasks[] = { //indexed per TASK_ defines
+  {taskInput,0,0},
+  {taskTimer,0,0},
+  {taskRTC,0,0},
+  {taskDisplay,0,1},
+  #ifdef ENABLE_NEOPIXEL
+  {taskPixel,0,1},
+  #endif
+  #ifdef PERSIST_STATE
+  {taskPersist,0,0},
+  #endif
+  #if TELEMETRY_LEVEL
+  {taskTelemetry,0,0},
+  #endif
+  #ifdef ENABLE_PROFILER
+  {taskProfiler,0,0},
+  #endif
+  #ifdef ESP32_DUAL_CORE
+  {taskRTCPoll,0,1},
+  #endif
+  #ifdef LIGHTSENSOR_VEML7700
+  {taskLight,0,1},
+  #endif
+};
+#define TASK_INPUT 0
+#define TASK_TIMER 1
+#define TASK_RTC 2
+#define TASK_DISPLAY 3
+#define TASK_PIXEL 4
+#define TASK_COUNT (sizeof(tasks)/sizeof(tasks[0]))
+static_assert(TASK_COUNT<=PROF_LATENCY, "profiler.h needs a stage per task");
+
+//The display state cycleDisplay works to – set by whatever wants to change it
+byte displayBrightness = 2; //the display normal/dim/off state
+#ifdef LIGHTSENSOR
+bool displayUseAmbient = 1; //whether normal brightness follows ambientLightLevel
+#else
+bool displayUseAmbient = 0;
+#endif
+word ambientLightLevel = 0; //0-255, per LUX_DIM-LUX_FULL
+byte fnSetPg = 0; //if we are setting
+
+void taskWake(byte t){
+  //Makes task t due now, e.g. when there's new work for it – so it runs this loop, if it comes after the caller, else next
+  #ifdef ESP32_DUAL_CORE
+  __atomic_store_n(&tasks[t].woken,1,__ATOMIC_RELEASE);
+  #else
+  tasks[t].woken = 1; //a byte store, so atomic against taskRun
+  #endif
+}
+bool taskRun(bool bus){ //"private"
+  //Runs each task that is due – of those for this core, if ESP32_DUAL_CORE. Returns whether any is due again already.
+  unsigned long now = millis();
+  byte t;
+  #ifdef ESP32_DUAL_CORE
+  if(bus) i2cPass(); //only the bus task uses it
+  #else
+  i2cPass();
+  #endif
+  for(t=0; t<TASK_COUNT; t++){
+    #ifdef ESP32_DUAL_CORE
+    if(tasks[t].bus!=bus) continue;
+    #endif
+    if(!tasks[t].woken && (long)(now-tasks[t].due)<0) continue; //not due yet
+    //Clear the wake before running, so one that comes in while it runs (e.g. from the other core) makes it run again, rather than being lost
+    #ifdef ESP32_DUAL_CORE
+    __atomic_exchange_n(&tasks[t].woken,0,__ATOMIC_ACQ_REL);
+    #else
+    tasks[t].woken = 0; //any wake before this is for work run() is about to do anyway
+    #endif
+    #ifdef ENABLE_PROFILER
+    unsigned long profStart = micros();
+    #endif
+    tasks[t].due = now+tasks[t].run(now);
+    #ifdef ENABLE_PROFILER
+    profRecord(t,micros()-profStart);
+    #endif
+    now = millis(); //since the task may have taken a while
+  }
+  for(t=0; t<TASK_COUNT; t++){
+    #ifdef ESP32_DUAL_CORE
+    if(tasks[t].bus!=bus) continue;
+    #endif
+    if(tasks[t].woken || (long)(now-tasks[t].due)>=0) return 1;
+  }
+  return 0;
+}
+void taskIdle(){ //"private"
+  //Called when no task is due, to save power until one is
+  #ifdef IDLE_SLEEP
+  if(idleReady()){ idleSleep(); return; }
+  #endif
+  #ifdef __AVR__
+  set_sleep_mode(SLEEP_MODE_IDLE); sleep_mode(); //any interrupt wakes us – at least every ms, per the millis() timer
+  #endif
+}
+#ifdef IDLE_SLEEP
+// Idle sleep
+// Once the stopwatch is cleared (e.g. by the STOPWATCH_TIMEOUT, see checkRTC) and left alone for STOPWATCH_TIMEOUT, there's
+// nothing to do until Sel is pressed, so the display goes into standby and the MCU sleeps until then (see inputSleep).
+// The press that wakes it is captured as usual, so it also starts the timer, timestamped as it happened.
+bool idleReady(){ //"private"
+  if(timerRunning || timerHeld) return 0;
+  if(inputBusy() || (unsigned long)(millis()-getInputLast())<STOPWATCH_TIMEOUT*1000) return 0;
+  #ifdef PERSIST_STATE
+  if(timerDirty || persistBusy()) return 0; //finish saving first
+  #endif
+  #if TELEMETRY_LEVEL
+  if(telemetryBusy()) return 0; //finish sending first
+  #endif
+  return 1;
+}
+void idleSleep(){ //"private"
+  #if TELEMETRY_LEVEL
+  Serial.flush(); //let the UART finish the last record
+  #endif
+  #ifdef ESP32_DUAL_CORE
+  busHold(1); //the bus task puts the display in standby, then waits
+  #else
+  displayStandby(1);
+  #endif
+  inputSleep(); //returns when Sel is pressed – or straight away, if an input was already in progress
+  #ifdef ESP32_DUAL_CORE
+  busHold(0);
+  #else
+  displayStandby(0);
+  #endif
+  millisReset(); //millis() may have stopped while asleep, so the next drift measurement would be bogus
+  taskWake(TASK_INPUT); //to pick up the press
+}
+#endif
+unsigned long taskInput(unsigned long now){
+  checkInputs(); //if inputs have changed, this will queue events
+  inputDrain(); //passes queued input events to ctrlEvt, which will do things + updateDisplay as needed
+  return TASK_INPUT_MS;
+}
+unsigned long taskTimer(unsigned long now){
+  cycleTimer(); //including any countdowns that have run out
+  cycleSignal();
+  sigArm(); //the soonest countdown deadline, once it's within reach
+  unsigned long next = TASK_IDLE_MS; //for channel cycling and arming deadlines – else timerStart wakes us
+  if(timerRunning&bit(timerCh)){
+    //Sleep until the shown timer is due to visibly change (see updateDisplay)
+    unsigned long long t = ms();
+    next = (timerRenderNext<=t? 0: (timerRenderNext-t<TASK_IDLE_MS? timerRenderNext-t: TASK_IDLE_MS));
+  }
+  if(signalBusy() && next>SIGNAL_CYCLE_MS) next = SIGNAL_CYCLE_MS; //to keep the beeps/pulses on time
+  if(timerRunning){
+    //Wake at the soonest countdown deadline, so cycleTimer runs it out on time – however long until the display next changes.
+    //(Where there's no deadline interrupt, that's also what signals it – see sigArm.)
+    unsigned long long t = ms();
+    for(byte c=0; c<TIMER_CHANNELS; c++){
+      if(!bitRead(timerRunning,c) || ((timerState[c]>>1)&1)) continue; //only running countdowns
+      if(timerTime[c]<=t) return 0;
+      if(timerTime[c]-t<next) next = timerTime[c]-t;
+    }
+  }
+  return next;
+}
+unsigned long taskRTC(unsigned long now){
+  checkRTC(false); //if clock has ticked, decrement timer if running, and updateDisplay
+  return RTC_POLL_MS;
+}
+unsigned long taskDisplay(unsigned long now){
+  cycleDisplay(displayBrightness,displayUseAmbient,ambientLightLevel,fnSetPg); //keeps the display hardware multiplexing cycle going
+  if(i2cPending(I2C_DISPLAY)) return 0; //it didn't get the bus this pass (see i2cBus.cpp)
+  return DISPLAY_CYCLE_MS; //or sooner, per updateDisplay
+}
+#ifdef ENABLE_NEOPIXEL
+unsigned long taskPixel(unsigned long now){
+  //Woken by checkRTC at each new second
+  const uint32_t colors[3] = {0xFF0000,0x00FF00,0x0000FF};
+  pixelColor = colors[rtcGetSecond()%3];
+  return pixelShow();
+}
+unsigned long pixelShow(){ //"private"
+  //Shows pixelColor, if it has changed – unless, per PIXEL_DEFER, a timer is running or an input is in progress, in which case
+  //it's left for later. Returns ms until taskPixel should try again.
+  if(pixelColor==pixelShown) return 60000; //nothing to do – until checkRTC wakes us
+  if(PIXEL_DEFER && (timerRunning || inputBusy())) return TASK_IDLE_MS;
+  pixels.fill(pixelColor); pixels.show();
+  pixelShown = pixelColor;
+  return 60000;
+}
+#endif
+#ifdef PERSIST_STATE
+unsigned long taskPersist(unsigned long now){
+  timerPersistCycle();
+  return (timerDirty || persistBusy()? 1: TASK_IDLE_MS); //EEPROM writes a byte every few ms
+}
+#endif
+#if TELEMETRY_LEVEL
+unsigned long taskTelemetry(unsigned long now){
+  telemetryCycle(); //sends queued telemetry, as the UART has room
+  return 1; //at 115200 baud, the UART sends about a frame per ms
+}
+#endif
+#ifdef LIGHTSENSOR_VEML7700
+unsigned long taskLight(unsigned long now){
+  unsigned long next = lightSample(); //on the sensor's own cadence (see lightVEML7700.cpp)
+  ambientLightLevel = lightGetLevel(); //only changes by whole brightness steps, so cycleDisplay only sets brightness when it should
+  return next;
+}
+#endif
+#ifdef ESP32_DUAL_CORE
+unsigned long taskRTCPoll(unsigned long now){
+  rtcPoll(); //reads the RTC, for checkRTC to take (see rtcTakeSnap)
+  return RTC_POLL_MS;
+}
+
+// Bus task
+// On ESP32_DUAL_CORE, this runs the bus tasks, pinned to core 0 (loop() runs on core 1). What passes between them:
+// display frames, via a lock-free mailbox (see displayPublish); RTC readings, via a sequence lock (see rtcPoll); task wakes, via
+// atomic flags (see taskWake); and otherwise single bytes or aligned words (e.g. displayBrightness), which are atomic.
+#if !defined(ESP32) || CONFIG_FREERTOS_UNICORE
+#error "ESP32_DUAL_CORE needs a dual-core ESP32"
+#endif
+#define BUS_TASK_STACK 4096
+volatile byte busHoldState = 0; //for idle sleep: 1 when loop() asks the bus task to put the display in standby and wait, 2 once it has
+void busTask(void *arg){ //"private"
+  for(;;){
+    if(busHoldState==1){
+      displayStandby(1); busHoldState = 2;
+      while(busHoldState) vTaskDelay(1);
+      displayStandby(0);
+    }
+    if(!taskRun(1)) vTaskDelay(1); //nothing due – let the idle task run (and feed its watchdog)
+  }
+}
+void busHold(bool on){
+  //Called by loop() around idle sleep, so the bus is quiet during it, and the display is in standby
+  if(!on){ busHoldState = 0; return; }
+  busHoldState = 1;
+  while(busHoldState!=2) delay(1);
+}
+#endif
+#ifdef ENABLE_PROFILER
+unsigned long taskProfiler(unsigned long now){
+  return (profCycle()? 1: TASK_IDLE_MS); //while dumping, top up the telemetry queue as it drains
+}
+#endif
+
+
+
 ////////// Main code control //////////
 
 void setup(){
@@ -49,11 +376,31 @@ void setup(){
     #endif
     Serial.println(F("Hello world"));
   }
+  #if TELEMETRY_LEVEL
+  if(!SHOW_SERIAL) telemetryInit(); //else Serial has already begun
+  #endif
+  for(byte c=0; c<TIMER_CHANNELS; c++){
+    timerDur[c] = TIMER_COUNTDOWN*1000UL; timerTime[c] = timerDur[c];
+    timerState[c] = TIMER_RUNOUT|(timerDur[c]? 0: 0b10); //count down, if a duration is set, else up
+  }
   rtcInit();
+  #ifdef TIMEBASE_32K
+  tbInit();
+  #endif
+  #ifdef PERSIST_STATE
+  timerRestore(); //before the first frame, so it shows the restored state
+  #endif
   initDisplay();
   initOutputs();
   initInputs();
+  #ifdef LIGHTSENSOR_VEML7700
+  lightInit();
+  #endif
+  i2cInit(); //now the modules have started the bus
   updateDisplay();
+  #ifdef ESP32_DUAL_CORE
+  xTaskCreatePinnedToCore(busTask,"bus",BUS_TASK_STACK,0,1,0,0); //same priority as loop(), on core 0
+  #endif
   
 
 #ifdef ENABLE_NEOPIXEL
@@ -68,48 +415,72 @@ void setup(){
   pixels.begin(); // INITIALIZE NeoPixel strip object (REQUIRED)
   pixels.setBrightness(20); // not so bright
 
-  pixels.fill(0xFFFFFF);
-  pixels.show();
+  pixelShow(); //white, per pixelColor
 #endif
 
 }
 
 void loop(){
-  //Every loop cycle, check the RTC and inputs (previously polled, but works fine without and less flicker)
-  checkRTC(false); //if clock has ticked, decrement timer if running, and updateDisplay
-  millisApplyDrift();
-  checkInputs(); //if inputs have changed, this will do things + updateDisplay as needed
-  cycleTimer();
-  cycleDisplay( //keeps the display hardware multiplexing cycle going
-    2, //displayBrightness, //the display normal/dim/off state
-    false,
-    0,
-    0 //if we are setting
-  );
+  //Run each task that is due (see Task scheduler), then idle until something else is
+  if(!taskRun(0)) taskIdle();
 }
 
 
-
 ////////// Input handling and value setting //////////
 
-void ctrlEvt(byte ctrl, byte evt, byte evtLast, bool velocity){
+void ctrlEvt(byte ctrl, byte evt, byte evtLast, word steps){
   //Handle control events from inputs, based on current fn and set state.
   //evt: 1=press, 2=short hold, 3=long hold, 4=verylong, 5=superlong, 0=release.
   //We only handle press evts for up/down ctrls, as that's the only evt encoders generate,
   //and input.cpp sends repeated presses if up/down buttons are held.
+  //steps: how many steps a press stands for – 1 for buttons, but an encoder sends all the detents turned since its last event in one (see checkRot).
   //But for sel/alt (always buttons), we can handle different hold states here.
 
+  //Any press silences a countdown signal that's going, as well as doing its thing
+  if(evt==1) signalStop();
+
   //For the stopwatch, controls are greatly simplified.
+  #if TIMER_CHANNELS>1
+  //Each control has its own channel. A press stops it if running, else starts it (from zero, or where a countdown left off) – and shows it on the display.
+  //(Only presses, since a press of one control while another is held only sends a press – see checkBtn.)
+  byte c = btnSlot(ctrl);
+  if(evt==1 && c<TIMER_CHANNELS){
+    unsigned long long at = msAtMicros(getInputEdgeMicros()); //the time the input actually happened, rather than now
+    if(bitRead(timerRunning,c)) timerStop(c,at); else timerStart(c,at);
+    timerShow(c);
+  }
+  #else
   //There's only one control. If it is pressed, start the timer if not already running.
   if(ctrl==CTRL_SEL) {
-    Serial.println(evt,DEC);
+    //The timer uses the time the input actually happened, rather than now
     if(evt==1){
-      if(!(timerState&1)) timerStart(); //if stopped
+      if(!bitRead(timerRunning,0)) timerStart(0,msAtMicros(getInputEdgeMicros())); //if stopped
     }
     if(evt==0){
-      timerStop();
+      timerStop(0,msAtMicros(getInputEdgeMicros()));
     }
   }
+  #endif
+  //Up/Dn, if not a channel's own control, set the duration the shown channel counts down from, while it's not running
+  if((ctrl==CTRL_UP || ctrl==CTRL_DN) && btnSlot(ctrl)>=TIMER_CHANNELS && evt==1 && !bitRead(timerRunning,timerCh)){
+    timerAdjust(timerCh,ctrl==CTRL_UP,steps);
+  }
+  #if LAP_COUNT
+  //Alt handles laps. While running, a press records a lap (Alt can be pressed while Sel is held – see checkBtn).
+  //While stopped, a short press (on release) pages back through the laps, and a short hold switches between lap times and splits.
+  if(ctrl==CTRL_ALT) {
+    if(bitRead(timerRunning,0)){
+      if(evt==1) timerLap(msAtMicros(getInputEdgeMicros()));
+    } else {
+      if(evt==0 && evtLast<2) timerLapPage();
+      if(evt==2 && (timerState[0]&16)){ timerState[0] ^= 32; fmtValid = 0; updateDisplay(); }
+    }
+  }
+  #endif
+  #ifdef ENABLE_PROFILER
+  //A long hold of Alt dumps the profiler stats over telemetry
+  if(ctrl==CTRL_ALT && evt==3) profDump();
+  #endif
   
 } //end ctrlEvt
 
@@ -125,23 +496,26 @@ void checkRTC(bool force){
   unsigned long now = millis();
   
   //Things to do every time this is called: timeouts to reset display. These may force a tick.
-  //Stopwatch timeout: If the stopwatch has been stopped long enough, clear it
-  if(timerTime && !(timerState&1) && (unsigned long)(now-getInputLast())>=STOPWATCH_TIMEOUT*1000){
-    timerClear();
+  //Stopwatch timeout: If the stopwatch has been stopped long enough, clear it (or any stopped channels)
+  if(timerHeld && (unsigned long)(now-getInputLast())>=STOPWATCH_TIMEOUT*1000){
+    for(byte c=0; c<TIMER_CHANNELS; c++) if(bitRead(timerHeld,c)) timerClear(c);
   }
   
   //Update things based on RTC
-  rtcTakeSnap();
+  rtcTakeSnap(force);
   
   if(rtcSecLast != rtcGetSecond() || force) { //If it's a new RTC second, or we are forcing it
 
     //Things to do at specific times
-    word todmins = rtcGetHour()*60+rtcGetMinute();
+    // word todmins = rtcGetHour()*60+rtcGetMinute(); //nothing is scheduled by time of day yet
     
+    #ifndef TIMEBASE_32K //with the 32kHz timebase, ms() already runs at the rtc's rate
     //Timer drift correction: per the millisCorrectionInterval
     if(rtcGetSecond()%millisCorrectionInterval==0){ //if time:
-      if(!(rtcDid&1)) millisCheckDrift(); bitWrite(rtcDid,0,1); //do if not done, set as done
+      if(!(rtcDid&1)) millisCheckDrift(); //do if not done
+      bitWrite(rtcDid,0,1); //set as done
     } else bitWrite(rtcDid,0,0); //if not time: set as not done
+    #endif
 
     //Finally, update the display, whether natural tick or not
     updateDisplay();
@@ -149,12 +523,7 @@ void checkRTC(bool force){
     rtcSecLast = rtcGetSecond();
     
 #ifdef ENABLE_NEOPIXEL
-    switch(rtcSecLast%3) {
-      case 0: pixels.fill(0xFF0000); pixels.show(); break;
-      case 1: pixels.fill(0x00FF00); pixels.show(); break;
-      case 2: pixels.fill(0x0000FF); pixels.show(); break;
-      default: break;
-    }
+    taskWake(TASK_PIXEL);
 #endif
     
   } //end if force or new second
@@ -162,152 +531,579 @@ void checkRTC(bool force){
 
 
 // Chrono/Timer
-// There are potentially two timing sources – the Arduino itself (eg millis()), which gives subsecond precision but isn't very accurate, so it's only good for short-term timing and taking action in response to user activity (eg button press hold thresholds); and the rtc, which is very accurate but only gives seconds, so it's only good for long-term timing and taking action in response to time of day. The one place we need both short-term precision and long-term accuracy is in the chrono/timer – so I have based it on millis() but with an offset applied to correct for its drift, periodically adjusted per the rtc.
-unsigned long millisDriftOffset = 0; //The cumulative running offset. Since it's circular, doesn't matter whether signed or not.
+// There are potentially two timing sources – the Arduino itself (eg millis()), which gives subsecond precision but isn't very accurate, so it's only good for short-term timing and taking action in response to user activity (eg button press hold thresholds); and the rtc, which is very accurate but only gives seconds, so it's only good for long-term timing and taking action in response to time of day. The one place we need both short-term precision and long-term accuracy is in the chrono/timer – so I have based it on millis() but with a rate correction applied, so it runs at the rtc's rate, as periodically measured against the rtc.
+// If the DS3231's 32kHz output is counted in hardware (TIMEBASE_32K), ms() comes from that instead, and none of this is needed.
+// ms() is 64-bit, so it doesn't wrap (in practice), and timestamps/durations based on it can use plain subtraction and comparison.
+// ms() is the millis() elapsed since an anchor point, scaled by the rate correction, plus the ms() value at that anchor. The rate is only changed at a new anchor, where ms() carries on from the value it had, and the scale is always positive – so ms() never steps, and never goes backward.
+#ifndef TIMEBASE_32K
+unsigned long long msAnchor = 0; //ms() at the anchor
+unsigned long millisAnchor = 0; //millis() at the anchor
+long millisRate = 0; //The rate correction, in units of 2^-24 (about 0.06ppm). Positive if millis() runs slow compared to the rtc.
+long millisFrac = 0; //fraction of a ms (in 2^-24 units) carried at the anchor, so moving the anchor doesn't accumulate rounding
+bool millisRateValid = 0; //whether millisRate has been measured yet
+#define MILLIS_RATE_MAX 65536 //2^16 units = ~3900ppm. Measurements beyond this are taken to be bogus (e.g. rtc was set) and ignored.
+#define MILLIS_ANCHOR_MAX 16384 //ms() moves its anchor forward at least this often, so the scaling math fits in a long (per MILLIS_RATE_MAX)
 //unsigned long millisAtLastCheck (defined at top, so ctrlEvt can reset it when setting RTC). 0 when unreliable (at start and after RTC set).
 //const byte millisCorrectionInterval (defined at top, so checkRTC can see it)
-int millisDriftBuffer = 0; // Each time we calculate millis() drift, we add it to this signed buffer, which gets applied to millisDriftOffset slowly to smooth the correction and minimize (eliminate?) the chance of a discontinuity, which prevents unsightly glitches in the chrono/timer and the signal performance, and failures in eg detecting button presses.
-// TODO the adjustments are a little noisy in the short term, because of a rolling offset between the loop cycle (slowed down by cycleDisplay's delays) and the rtc ticks. It's kind of academic since the variance is probably only around ±.02sec per adjustment at most (largely the duration of cycleDisplay's delays), which I'd say is within the tolerance of display/button/human limitations, but no point doing it as quickly as once per second I think.
 void millisCheckDrift(){
-  unsigned long now = millis();
+  unsigned long now = rtcGetSecondStart(); //millis() when the current RTC second started, as near as the RTC module can tell (exact, if using the DS3231 SQW tick)
   if(millisAtLastCheck){ // if this has a value, check to see how much millis has drifted since then. If this is 0, it means either the RTC was recently set (or the extremely unlikely case that the last sync occurred exactly at millis rollover) so we will hold off until next drift check.
-    long millisDrift = now-(millisAtLastCheck+(millisCorrectionInterval*1000)); // Converting difference to a signed long.
-    if(abs((long)(millisDrift+millisDriftBuffer))>32767){} // If adding drift to buffer would make it overflow, ignore it this time
-    else {
-      millisDriftBuffer -= millisDrift;
-      // rtcTakeSnap();
-      // if(rtcGetHour()<10) Serial.print(F("0"));
-      // Serial.print(rtcGetHour(),DEC);
-      // Serial.print(F(":"));
-      // if(rtcGetMinute()<10) Serial.print(F("0"));
-      // Serial.print(rtcGetMinute(),DEC);
-      // Serial.print(F(":"));
-      // if(rtcGetSecond()<10) Serial.print(F("0"));
-      // Serial.print(rtcGetSecond(),DEC);
-      // Serial.print(F("  millis: "));
-      // Serial.print(now,DEC);
-      // Serial.print(F("  drift: "));
-      // Serial.print(millisDrift,DEC);
-      // Serial.print(F("  new buffer: "));
-      // Serial.print(millisDriftBuffer,DEC);
-      // Serial.println();
+    long millisEl = now-millisAtLastCheck; //millis() elapsed over millisCorrectionInterval rtc seconds
+    long millisDrift = millisEl-((long)millisCorrectionInterval*1000); //positive if millis() ran fast
+    //Convert to a rate correction: how much to scale millis() by so it would have matched the rtc
+    if(abs(millisDrift)*(0x1000000/MILLIS_RATE_MAX) < millisEl) { //i.e. within MILLIS_RATE_MAX, else ignore it this time
+      long rateMeas = -(((long long)millisDrift<<24)/millisEl); //in long long, as millisDrift<<24 overflows a long past 127ms; the quotient fits, being within MILLIS_RATE_MAX
+      //Filter it into the rate, to smooth out the noise of individual measurements (e.g. from rtc polling)
+      millisSetRate(millisRateValid? millisRate+((rateMeas-millisRate+2)>>2): rateMeas);
+      millisRateValid = 1;
+      if(TELEMETRY_LEVEL>=2) telemetryLog(TELEM_DRIFT,0,millisRate);
     }
   }
   millisAtLastCheck = now;
 }
-void millisApplyDrift(){
-  //Applies millisDriftBuffer to millisDriftOffset at the rate of 1ms per loop. See above for details.
-  if(millisDriftBuffer){
-    millisDriftOffset += (millisDriftBuffer>0? 1: -1);
-    millisDriftBuffer -= (millisDriftBuffer>0? 1: -1);
-    // tod = rtc.now();
-    // if(rtcGetHour()<10) Serial.print(F("0"));
-    // Serial.print(rtcGetHour(),DEC);
-    // Serial.print(F(":"));
-    // if(rtcGetMinute()<10) Serial.print(F("0"));
-    // Serial.print(rtcGetMinute(),DEC);
-    // Serial.print(F(":"));
-    // if(rtcGetSecond()<10) Serial.print(F("0"));
-    // Serial.print(rtcGetSecond(),DEC);
-    // Serial.print(F("  new offset: "));
-    // Serial.print(millisDriftOffset,DEC);
-    // Serial.print(F("  new buffer: "));
-    // Serial.print(millisDriftBuffer,DEC);
-    // Serial.println();
-  }
+void millisSetRate(long rate){
+  //Moves the anchor to now, so ms() carries on from where it is, at the new rate
+  unsigned long now = millis();
+  msAtMillis(now); //moves the anchor to within MILLIS_ANCHOR_MAX of now
+  millisAdvance(now-millisAnchor);
+  millisRate = rate;
+}
+void millisAdvance(unsigned long el){
+  //Moves the anchor forward by el millis (less than MILLIS_ANCHOR_MAX), carrying the fraction
+  long corr = (long)el*millisRate+millisFrac;
+  msAnchor += el+(corr>>24); millisAnchor += el; millisFrac = corr&0xFFFFFF;
 }
 void millisReset(){
   millisAtLastCheck = 0; //because setting the RTC makes this unreliable
 }
-unsigned long ms(){
-  // Returns millis() with the drift offset applied, for timer/chrono purposes.
-  // WARNING: Since the offset is being periodically adjusted, there is the possibility of a discontinuity in ms() output – if we give out a timestamp and then effectively set the clock back, the next timestamp might possibly be earlier than the last one, which could mess up duration math. I tried to think of a way to monitor for that discontinuity – e.g. if now-then is greater than then-now, due to overflow – but it gets tricky since millis() is effectively circular, and that condition occurs naturally at rollover as well – so I think we would need a flag that millisCheckDrift sets when it sets the offset backward, and ms clears when the real time has caught up.... or something like that.
-  // So for now we'll restrict use of ms() to the timer/chrono duration – the only place we really need it, and fortunately it's not a problem here, because that duration never exceeds 100 hours so we can easily detect that overflow. And the only time it might really be an issue is if it occurs immediately after the chrono starts, since it would briefly display the overflowed time – in that case we'll just reset the timer to 0 and keep going.
-  return (unsigned long)(millis()+millisDriftOffset);
+unsigned long long msAtMillis(unsigned long m){
+  // Returns ms() as of millis() value m, which must be no earlier than the anchor (and no more than 49 days later, since millis() wraps – ms() is called far more often than that).
+  while((unsigned long)(m-millisAnchor)>=MILLIS_ANCHOR_MAX) millisAdvance(MILLIS_ANCHOR_MAX);
+  unsigned long el = m-millisAnchor;
+  return msAnchor+el+(((long)el*millisRate+millisFrac)>>24);
 }
-void timerStart(){
-  timerTime = 0; //stopwatch should always start from zero
-  bitWrite(timerState,0,1); //set timer running (bit 0) to on (1)
-  if(timerTime==0) bitWrite(timerState,1,1); //set timer direction (bit 1) to up (1) if we were idle
+unsigned long long ms(){
+  // Returns millis() with the rate correction applied, for timer/chrono purposes. Monotonic (see above).
+  return msAtMillis(millis());
+}
+#else
+void millisReset(){} //ms() does not depend on millis(), so there is nothing to reset
+unsigned long long ms(){
+  // Returns the 32kHz count in ms, for timer/chrono purposes. Monotonic, and as accurate as the rtc.
+  return tbMillis();
+}
+#endif //TIMEBASE_32K
+unsigned long long msAtMicros(unsigned long us){
+  // Returns ms() as it was at micros() timestamp us – e.g. an input edge captured by interrupt – for timer/chrono purposes.
+  return ms()-(micros()-us)/1000;
+}
+void timerStart(byte c, unsigned long long at){
+  //c is the channel; at is the ms() timestamp to start from – normally now, or when the input happened
+  //A countdown starts from where it was stopped (or from its duration, if it ran out) – anything else, from zero, counting up
+  if(!((timerState[c]>>1)&1) && !timerTime[c]) timerTime[c] = timerDur[c];
+  if(((timerState[c]>>1)&1) || !timerTime[c]){ timerTime[c] = 0; bitWrite(timerState[c],1,1); }
+  #if LAP_COUNT
+  lapTotal = 0; lapSplit = 0; bitWrite(timerState[c],4,0);
+  #endif
+  bitWrite(timerRunning,c,1); //set timer running
+  bitWrite(timerHeld,c,0);
   //When the timer is stopped, timerTime holds a duration, independent of any start/stop time.
   //Convert it to a timestamp:
   //If chrono (count up), timestamp is an origin in the past: now minus duration.
   //If timer (count down), timestamp is a destination in the future: now plus duration.
-  timerTime = ((timerState>>1)&1? ms() - timerTime: ms() + timerTime);
+  timerTime[c] = ((timerState[c]>>1)&1? at - timerTime[c]: at + timerTime[c]);
+  timerDirty = 1;
+  telemetryLog(TELEM_START,c,at);
+  signalSwitch(); sigArm();
+  if(c==timerCh){ fmtValid = 0; taskWake(TASK_TIMER); } //so cycleTimer shows it
 } //end timerStart()
-void timerStop(){
-  bitWrite(timerState,0,0); //set timer running (bit 0) to off (0)
+void timerStop(byte c, unsigned long long at){
+  //c is the channel; at is the ms() timestamp to stop at – normally now, or when the input happened
+  bitWrite(timerRunning,c,0); //set timer running to off
+  bitWrite(timerHeld,c,1);
   //When the timer is running, timerTime holds a timestamp, which the current duration is continuously calculated from.
   //Convert it to a duration:
   //If chrono (count up), timestamp is an origin in the past: duration is now minus timestamp.
   //If timer (count down), timestamp is a destination in the future: duration is timestamp minus now.
-  timerTime = ((timerState>>1)&1? ms() - timerTime: timerTime - ms());
-  updateDisplay(); //since cycleTimer won't do it
+  //(If a countdown's deadline has passed, but cycleTimer hasn't run it out yet, it's stopped at zero.)
+  timerTime[c] = ((timerState[c]>>1)&1? at - timerTime[c]: (timerTime[c]>at? timerTime[c] - at: 0));
+  #if LAP_COUNT
+  bitWrite(timerState[c],4,0); //show the final time, rather than a lap
+  #endif
+  timerDirty = 1;
+  telemetryLog(TELEM_STOP,c,timerTime[c]);
+  signalSwitch(); sigArm();
+  if(c==timerCh){ fmtValid = 0; updateDisplay(); } //since cycleTimer won't do it
 }
-void timerClear(){
-  bitWrite(timerState,0,0); //set timer running (bit 0) to off (0)
-  timerTime = 0; //set timer duration
-  updateDisplay();
+void timerClear(byte c){
+  bitWrite(timerRunning,c,0); //set timer running to off
+  bitWrite(timerHeld,c,0);
+  timerTime[c] = timerDur[c]; //set timer duration – to count down from, if set, else up from zero
+  bitWrite(timerState[c],1,!timerDur[c]);
+  #if LAP_COUNT
+  lapTotal = 0; lapSplit = 0; bitWrite(timerState[c],4,0);
+  #endif
+  timerDirty = 1;
+  telemetryLog(TELEM_CLEAR,c,0);
+  signalSwitch(); sigArm();
+  if(c==timerCh){ fmtValid = 0; updateDisplay(); }
+}
+void timerSetDur(byte c, unsigned long dur){
+  //Sets the duration channel c counts down from (0 to count up), and clears it to that
+  timerDur[c] = dur;
+  timerClear(c);
+}
+#ifndef TIMER_DUR_MAX
+#define TIMER_DUR_MAX 359999000UL //ms – 99:59:59
+#endif
+void timerAdjust(byte c, bool up, word steps){ //"private"
+  //Steps channel c's duration up or down, by a unit that grows with it: seconds under a minute, 10 seconds under 10 minutes,
+  //minutes under an hour, else 10 minutes – snapping to that unit as it goes. Down to 0 makes it count up.
+  unsigned long dur = timerDur[c];
+  for(; steps; steps--){
+    if(up? dur>=TIMER_DUR_MAX: !dur) break;
+    unsigned long d = (up? dur: dur-1); //the unit is per the span being stepped through
+    unsigned long unit = (d<60000UL? 1000UL: d<600000UL? 10000UL: d<3600000UL? 60000UL: 600000UL);
+    dur = (up? (dur/unit+1)*unit: ((dur-1)/unit)*unit);
+  }
+  if(dur>TIMER_DUR_MAX) dur = TIMER_DUR_MAX;
+  if(dur!=timerDur[c] || timerTime[c]!=dur) timerSetDur(c,dur); //a paused timer is cleared, even at the limits
 }
+#if TIMER_CHANNELS>1
+void timerShow(byte c){
+  //Shows channel c on the display
+  timerCh = c; timerCycleLast = millis();
+  fmtValid = 0; updateDisplay();
+}
+#endif
+void timerRunout(byte c){ //"private"
+  //Called by cycleTimer once countdown c has reached its deadline: signals it (unless the deadline interrupt already has – see sigArm),
+  //then starts it over, carries on counting up, or stops it at zero, per timerState
+  unsigned long long at = timerTime[c]; //the deadline
+  if(!sigTake(c)) signalOn(c);
+  signalStart(at,timerState[c]&4);
+  telemetryLog(TELEM_RUNOUT,c,at);
+  if((timerState[c]&4) && timerDur[c]) timerTime[c] = at+timerDur[c]; //start over: the next deadline is from this one, so it doesn't drift
+  else if(timerState[c]&8) bitWrite(timerState[c],1,1); //carry on counting up: the deadline is now the origin
+  else { bitWrite(timerRunning,c,0); bitWrite(timerHeld,c,1); timerTime[c] = 0; } //stop at zero
+  timerDirty = 1;
+  signalSwitch();
+  if(c==timerCh){ fmtValid = 0; updateDisplay(); }
+}
+#if LAP_COUNT
+void timerLap(unsigned long long at){
+  //Records a lap at ms() timestamp at – normally when the input happened. No I/O, so it's fine in the event path.
+  if(!((timerState[0]>>1)&1)) return; //chrono only
+  unsigned long long split = at-timerTime[0];
+  lapDelta[lapTotal&(LAP_COUNT-1)] = split-lapSplit; //overwrites the oldest, once full
+  lapSplit = split; lapTotal++;
+  telemetryLog(TELEM_LAP,lapTotal,lapDelta[(lapTotal-1)&(LAP_COUNT-1)]);
+  //Show the new lap for a bit
+  bitWrite(timerState[0],4,1); lapView = 0; lapShowUntil = at+LAP_SHOW_DUR;
+  fmtValid = 0; timerRenderNext = 0; taskWake(TASK_TIMER); //so cycleTimer shows it
+}
+void timerLapPage(){
+  //While stopped, steps the display back through the laps (lap display, from the latest to the oldest), then back to the total
+  word n = (lapTotal<LAP_COUNT? lapTotal: LAP_COUNT);
+  if(!n) return;
+  if(!(timerState[0]&16)){ bitWrite(timerState[0],4,1); lapView = 0; }
+  else if(++lapView>=n){ bitWrite(timerState[0],4,0); lapView = 0; }
+  fmtValid = 0; updateDisplay();
+}
+unsigned long long timerLapValue(byte back){
+  //Returns the lap time of the lap back from the latest – or its split, per timerState bit 5
+  if(!(timerState[0]&32)) return lapDelta[(word)(lapTotal-1-back)&(LAP_COUNT-1)];
+  unsigned long long split = lapSplit;
+  for(byte k=0; k<back; k++) split -= lapDelta[(word)(lapTotal-1-k)&(LAP_COUNT-1)];
+  return split;
+}
+#endif
 void cycleTimer(){
-  if(timerState&1){ //If the timer is running
-    //Check if we've hit a wall
-    if((unsigned long)(ms()-timerTime)>=360000000){ //find out if now is over the amount we can display (100h, or 360M ms)
-      //chrono has maxed out
-      // if it has maxed out by a LOT, it was probably due to a rare overflow possibility right after starting (see ms()) – so just restart.
-      if((unsigned long)(ms()-timerTime)>=370000000) timerTime = ms();
-      else timerClear();
-      //Serial.println(F("wat"));
+  #if TIMER_CHANNELS>1 && defined(TIMER_CYCLE_DUR)
+  //Cycle the display through the channels, when there has been no input for a bit
+  if((unsigned long)(millis()-timerCycleLast)>=TIMER_CYCLE_DUR && (unsigned long)(millis()-getInputLast())>=TIMER_CYCLE_DUR) timerShow((timerCh+1)%TIMER_CHANNELS);
+  #endif
+  //Countdowns that have reached their deadlines run out
+  if(timerRunning){
+    unsigned long long now = ms();
+    for(byte c=0; c<TIMER_CHANNELS; c++){
+      if(bitRead(timerRunning,c) && !((timerState[c]>>1)&1) && now>=timerTime[c]) timerRunout(c);
     }
-    updateDisplay();
+  }
+  //Otherwise, stopped channels need nothing doing (and running ones not shown on the display, since their timestamps say it all)
+  if(timerRunning&bit(timerCh)){ //If the shown timer is running
+    #if LAP_COUNT
+    //Go back from showing a new lap to the running chrono
+    if((timerState[0]&16) && ms()>=lapShowUntil){ bitWrite(timerState[0],4,0); fmtValid = 0; timerRenderNext = 0; }
+    #endif
+    //Only update the display when a visible digit is due to change (see updateDisplay)
+    if(ms()>=timerRenderNext) updateDisplay();
   }
 } //end cycleTimer()
 
+#ifdef PERSIST_STATE
+// Timer persistence
+// When timer state changes (start/stop/clear), it's checkpointed to EEPROM (see persist.cpp), so it can be restored after a power cut.
+// Running timers are saved as their duration at an rtc timestamp, so on restore, they carry on as though they'd never stopped.
+// Laps are not saved.
+struct TimerRec {
+  unsigned long stamp; //when the record was made – rtc seconds since 2000, as of the start of that second
+  word running; //per timerRunning
+  byte state[TIMER_CHANNELS]; //per timerState
+  unsigned long long td[TIMER_CHANNELS]; //duration – as of stamp, if running
+  unsigned long dur[TIMER_CHANNELS]; //per timerDur
+};
+TimerRec timerRec; //the record being saved (or loaded)
+const word monthStarts[12] = {0,31,59,90,120,151,181,212,243,273,304,334}; //day of the year each month starts on, if not a leap year
+unsigned long rtcStamp(){
+  //The rtc snapshot's time, in seconds since 2000-01-01
+  word y = rtcGetYear()-2000; byte m = rtcGetMonth();
+  word days = y*365+(y+3)/4+monthStarts[m-1]+rtcGetDate()-1; //(y+3)/4 is the leap days in the years before
+  if(m>2 && y%4==0) days++; //this year's leap day
+  return days*86400UL+rtcGetHour()*3600UL+rtcGetMinute()*60+rtcGetSecond();
+}
+void timerSnapshot(){ //"private"
+  //Fills timerRec from the current timer state
+  unsigned long long now = ms();
+  unsigned long sinceSec = millis()-rtcGetSecondStart(); //how far we are into the current rtc second
+  timerRec.stamp = rtcStamp();
+  timerRec.running = timerRunning;
+  for(byte c=0; c<TIMER_CHANNELS; c++){
+    timerRec.state[c] = timerState[c];
+    timerRec.dur[c] = timerDur[c];
+    timerRec.td[c] = (!bitRead(timerRunning,c)? timerTime[c]: //stopped: duration
+      ((timerState[c]>>1)&1? now - sinceSec - timerTime[c]: //count up: elapsed at the start of the second
+        timerTime[c] - (now - sinceSec) //count down: remaining at the start of the second
+      )
+    );
+  }
+}
+void timerRestore(){
+  //Called at setup: restores the timer state from the latest checkpoint, if any
+  static_assert(PERSIST_ADDR+PERSIST_SLOTS*(sizeof(timerRec)+4)<=PERSIST_EEPROM_SIZE, "PERSIST_SLOTS of timerRec don't fit the EEPROM from PERSIST_ADDR");
+  persistInit(sizeof(timerRec));
+  if(!persistLoad((byte*)&timerRec)) return;
+  unsigned long long now = ms();
+  #ifdef RTC_MILLIS
+    bool anchored = 0; //the fake rtc doesn't survive a power cut, so running timers can only be restored as stopped
+    unsigned long long el = 0;
+  #else
+    rtcTakeSnap(true);
+    unsigned long stampNow = rtcStamp();
+    bool anchored = (stampNow>=timerRec.stamp);
+    //Time since the stamp. Until the rtc ticks, we don't know exactly when its second started, so this may be up to a second out.
+    unsigned long long el = (unsigned long long)(stampNow-timerRec.stamp)*1000+(millis()-rtcGetSecondStart());
+  #endif
+  for(byte c=0; c<TIMER_CHANNELS; c++){
+    timerState[c] = timerRec.state[c]&~bit(4); //not lap display
+    timerDur[c] = timerRec.dur[c];
+    unsigned long long td = timerRec.td[c];
+    if(bitRead(timerRec.running,c) && anchored){
+      if((timerState[c]>>1)&1) timerTime[c] = now-(td+el); //count up: the origin
+      else if(td>el) timerTime[c] = now+(td-el); //count down: the target
+      else { timerTime[c] = 0; continue; } //count down that ran out while off
+      bitWrite(timerRunning,c,1);
+    } else {
+      timerTime[c] = td;
+      if(td) bitWrite(timerHeld,c,1);
+    }
+  }
+}
+void timerPersistCycle(){
+  //Called every loop: once timer state has changed and the last save is done, saves a checkpoint, a byte at a time (see persistCycle)
+  if(timerDirty && !persistBusy()){ timerDirty = 0; timerSnapshot(); persistSave((byte*)&timerRec); }
+  persistCycle();
+}
+#endif //PERSIST_STATE
+
+// Incremental time formatter
+// Breaking the timer duration down into d/h/m/s/cs takes several 32-bit divisions, which are slow in software on AVR (no hardware divider), so rather than doing that every frame, we keep the duration broken down into unpacked BCD digits, and step them forward or back by the (usually small) change since the last frame. A full conversion is only done when the timer is started/stopped/cleared, or if the duration has changed by a lot.
+#define FMT_DIGITS 10
+const byte fmtLim[FMT_DIGITS] = {10,10,10,10,6,10,6,24,10,10}; //ms, cs ones, cs tens, s ones, s tens, m ones, m tens, h (as one digit, 0-23), d ones, d tens
+byte fmtDig[FMT_DIGITS] = {0,0,0,0,0,0,0,0,0,0}; //the duration, as a digit per fmtLim. Days wrap after 99.
+unsigned long long fmtVal = 0; //the duration, as represented by fmtDig
+//bool fmtValid (defined at top, so timerStart/Stop/Clear can reset it)
+#define FMT_STEP_MAX 60000 //ms – if the duration has changed by this much or more, do a full conversion rather than stepping
+void fmtStep(byte k, byte n, bool up){
+  //Adds n to (or subtracts n from) fmtDig[k], rippling any carry/borrow up through the higher digits. n must be less than fmtLim[k].
+  for(; k<FMT_DIGITS; k++){
+    if(up){ fmtDig[k] += n; if(fmtDig[k]<fmtLim[k]) return; fmtDig[k] -= fmtLim[k]; }
+    else { if(fmtDig[k]>=n){ fmtDig[k] -= n; return; } fmtDig[k] += fmtLim[k]-n; }
+    n = 1; //carry/borrow
+  }
+}
+void fmtUpdate(unsigned long long td){
+  //Brings fmtDig up to date with duration td (ms)
+  bool up = (td>=fmtVal);
+  unsigned long long dd = (up? td-fmtVal: fmtVal-td);
+  fmtVal = td;
+  if(!fmtValid || dd>=FMT_STEP_MAX){ //full conversion
+    fmtValid = 1;
+    unsigned long secs = td/1000; //the only 64-bit division
+    word mils = td-secs*1000ULL;
+    fmtDig[0] = mils%10; fmtDig[1] = (mils/10)%10; fmtDig[2] = mils/100;
+    byte part = secs%60; fmtDig[3] = part%10; fmtDig[4] = part/10; //seconds
+    part = (secs/60)%60; fmtDig[5] = part%10; fmtDig[6] = part/10; //minutes
+    fmtDig[7] = (secs/3600)%24; //hours
+    part = (secs/86400)%100; fmtDig[8] = part%10; fmtDig[9] = part/10; //days (up to 99)
+    return;
+  }
+  //Step by the delta, one decimal place at a time, by subtraction only
+  unsigned long delta = dd; //less than FMT_STEP_MAX
+  byte n;
+  while(delta>=1000){ delta-=1000; fmtStep(3,1,up); } //seconds
+  for(n=0; delta>=100; n++) delta-=100;
+  fmtStep(2,n,up); //tenths
+  for(n=0; delta>=10; n++) delta-=10;
+  fmtStep(1,n,up); //hundredths
+  fmtStep(0,delta,up); //thousandths
+}
+
 void updateDisplay(){
   //Run as needed to update display when the value being shown on it has changed
   //This formats the new value and puts it in displayNext[] for cycleDisplay() to pick up
 
-  unsigned long td; td = (!(timerState&1)? timerTime: //If stopped, use stored duration
+  unsigned long long now; now = ms();
+  unsigned long long td; td = (!bitRead(timerRunning,timerCh)? timerTime[timerCh]: //If stopped, use stored duration
     //If running, use same math timerStop() does to calculate duration
-    ((timerState>>1)&1? ms() - timerTime: //count up
-      timerTime - ms() //count down
+    ((timerState[timerCh]>>1)&1? now - timerTime[timerCh]: //count up
+      (timerTime[timerCh]>now? timerTime[timerCh] - now: 0) //count down – at zero, until cycleTimer runs it out
     )
   );
-  byte tdc; tdc = (td%1000)/10; //capture hundredths (centiseconds)
-  td = td/1000+(!((timerState>>1)&1)&&tdc!=0?1:0); //remove mils, and if countdown, round up
+  #if LAP_COUNT
+  if(timerState[timerCh]&16) td = timerLapValue(lapView); //lap display (chrono only)
+  #endif
+  //If countdown, round up to the next second, unless we're within 10ms of it – i.e. td/1000, plus 1 if there are any hundredths
+  fmtUpdate((timerState[timerCh]>>1)&1? td: td+990);
+  bool days; days = fmtDig[9]||fmtDig[8]>4||(fmtDig[8]==4&&fmtDig[7]>=4); //td>=100h
+  bool hrs;  hrs  = fmtDig[9]||fmtDig[8]||fmtDig[7]; //td>=1h
+  bool mins; mins = hrs||fmtDig[6]||fmtDig[5]; //td>=1m
+  bool secs; secs = mins||fmtDig[4]||fmtDig[3]; //td>=1s
+  byte hh; hh = (days? fmtDig[7]: fmtDig[8]*24+fmtDig[7]); //hours shown: of the day if showing days, else in total (under 100)
   //Countdown shows H:M:S, but on DISPLAY_SIZE<6 and H<1, M:S
   //Countup shows H:M:S, but if H<1, M:S:C, but if DISPLAY_SIZE<6 and M<1, S:C
+  //Either way, from 100h, D:H:M (so 4-digit displays show D:H)
   bool lz; lz = 1; //leading zeroes
-  if((timerState>>1)&1){ //count up
-    if(DISPLAY_SIZE<6 && td<60){ //under 1 min, 4-digit displays: [SS]CC--
-      if(td>=1||lz) editDisplay(td,0,1,lz,true); else blankDisplay(0,1,true); //secs, leading per lz, fade
-      editDisplay(tdc,2,3,td>=1||lz,false); //cents, leading if >=1sec or lz, no fade
+  //Per the format shown, work out how long until a visible digit changes, so cycleTimer can skip updates until then
+  word tdMils; tdMils = fmtDig[2]*100+fmtDig[1]*10+fmtDig[0]; //mils into the current second
+  if((timerState[timerCh]>>1)&1){ //count up: next hundredth, if shown, else next second
+    timerRenderNext = now + ((DISPLAY_SIZE<6? !mins: !hrs)? 10-fmtDig[0]: 1000-tdMils);
+  } else { //count down: next second, per the rounding above
+    timerRenderNext = now + tdMils + 1;
+  }
+  #if LAP_COUNT
+  if(timerState[timerCh]&16) timerRenderNext = lapShowUntil; //a lap doesn't change while shown
+  #endif
+  if((timerState[timerCh]>>1)&1){ //count up
+    if(DISPLAY_SIZE<6 && !mins){ //under 1 min, 4-digit displays: [SS]CC--
+      if(secs||lz) editDisplayPair(fmtDig[4],fmtDig[3],0,lz,true); else blankDisplay(0,1,true); //secs, leading per lz, fade
+      editDisplayPair(fmtDig[2],fmtDig[1],2,secs||lz,false); //cents, leading if >=1sec or lz, no fade
       blankDisplay(4,5,true); //just in case 4-digit code's running on a 6-digit display, don't look ugly
-    } else if(td<3600){ //under 1 hr: [MM][SS]CC
-      if(td>=60||lz) editDisplay(td/60,0,1,lz,true); else blankDisplay(0,1,true); //mins, leading per lz, fade
-      if(td>=1||lz) editDisplay(td%60,2,3,td>=60||lz,true); else blankDisplay(2,3,true); //secs, leading if >=1min or lz, fade
-      editDisplay(tdc,4,5,td>=1||lz,false); //cents, leading if >=1sec or lz, no fade - hidden on 4-digit display
-    } else { //over 1 hr: HHMMSS
-      editDisplay(td/3600,0,1,lz,true); //hrs, leading per lz, fade
-      editDisplay((td%3600)/60,2,3,true,true); //mins, leading, fade
-      editDisplay(td%60,4,5,true,true); //secs, leading, fade
+    } else if(!hrs){ //under 1 hr: [MM][SS]CC
+      if(mins||lz) editDisplayPair(fmtDig[6],fmtDig[5],0,lz,true); else blankDisplay(0,1,true); //mins, leading per lz, fade
+      if(secs||lz) editDisplayPair(fmtDig[4],fmtDig[3],2,mins||lz,true); else blankDisplay(2,3,true); //secs, leading if >=1min or lz, fade
+      editDisplayPair(fmtDig[2],fmtDig[1],4,secs||lz,false); //cents, leading if >=1sec or lz, no fade - hidden on 4-digit display
+    } else if(!days){ //under 100 hrs: HHMMSS
+      editDisplayPair(hh/10,hh%10,0,lz,true); //hrs, leading per lz, fade
+      editDisplayPair(fmtDig[6],fmtDig[5],2,true,true); //mins, leading, fade
+      editDisplayPair(fmtDig[4],fmtDig[3],4,true,true); //secs, leading, fade
+    } else { //over 100 hrs: DDHHMM
+      editDisplayPair(fmtDig[9],fmtDig[8],0,lz,true); //days, leading per lz, fade
+      editDisplayPair(hh/10,hh%10,2,true,true); //hrs, leading, fade
+      editDisplayPair(fmtDig[6],fmtDig[5],4,true,true); //mins, leading, fade
     }
   } else { //count down
-    if(DISPLAY_SIZE<6 && td<3600){ //under 1 hr, 4-digit displays: [MM]SS--
-      if(td>=60||lz) editDisplay(td/60,0,1,lz,true); else blankDisplay(0,1,true); //mins, leading per lz, fade
-      if(td>=1||lz) editDisplay(td%60,2,3,td>=60||lz,true); else blankDisplay(2,3,true); //secs, leading if >=1min or lz, fade
+    if(DISPLAY_SIZE<6 && !hrs){ //under 1 hr, 4-digit displays: [MM]SS--
+      if(mins||lz) editDisplayPair(fmtDig[6],fmtDig[5],0,lz,true); else blankDisplay(0,1,true); //mins, leading per lz, fade
+      if(secs||lz) editDisplayPair(fmtDig[4],fmtDig[3],2,mins||lz,true); else blankDisplay(2,3,true); //secs, leading if >=1min or lz, fade
       blankDisplay(4,5,true); //just in case 4-digit code's running on a 6-digit display, don't look ugly
-    } else { //[HH][MM]SS
-      if(td>=3600||lz) editDisplay(td/3600,0,1,lz,true); else blankDisplay(0,1,true); //hrs, leading per lz, fade
-      if(td>=60||lz) editDisplay((td%3600)/60,2,3,td>=3600||lz,true); else blankDisplay(2,3,true); //mins, leading if >=1h or lz, fade
-      editDisplay(td%60,4,5,td>=60||lz,true); //secs, leading if >=1m or lz, fade
+    } else if(!days){ //[HH][MM]SS
+      if(hrs||lz) editDisplayPair(hh/10,hh%10,0,lz,true); else blankDisplay(0,1,true); //hrs, leading per lz, fade
+      if(mins||lz) editDisplayPair(fmtDig[6],fmtDig[5],2,hrs||lz,true); else blankDisplay(2,3,true); //mins, leading if >=1h or lz, fade
+      editDisplayPair(fmtDig[4],fmtDig[3],4,mins||lz,true); //secs, leading if >=1m or lz, fade
+    } else { //DDHHMM
+      editDisplayPair(fmtDig[9],fmtDig[8],0,lz,true); //days, leading per lz, fade
+      editDisplayPair(hh/10,hh%10,2,true,true); //hrs, leading, fade
+      editDisplayPair(fmtDig[6],fmtDig[5],4,true,true); //mins, leading, fade
     }
   }
+  displayPublish(); //done staging
+  taskWake(TASK_DISPLAY); //to send it
        
 } //end updateDisplay()
 
 
 ////////// Hardware outputs //////////
 
+// Countdown signal
+// When a countdown runs out, it's signalled per TIMER_SIGNAL: the piezo beeps, or the pulse output pulses, once a second for SIGNAL_DUR
+// (or just once, if the countdown starts over – see timerState bit 2); or the switch output, which is on while a countdown runs, goes off.
+// So that the signal starts on time, however busy the loop is, the soonest deadline is armed on a hardware timer (see sigArm), which
+// starts the output within a tick of it – rather than whenever cycleTimer next looks. cycleTimer then runs the countdown out (see
+// timerRunout), and cycleSignal carries on the beeps/pulses from there. Any press silences them.
+#ifndef PIEZO_PIN
+#define PIEZO_PIN -1
+#endif
+#ifndef SWITCH_PIN
+#define SWITCH_PIN -1
+#endif
+#ifndef PULSE_PIN
+#define PULSE_PIN -1
+#endif
+#ifndef TIMER_SIGNAL
+#define TIMER_SIGNAL 0 //0=piezo, 1=switch, 2=pulse
+#endif
+#ifndef SIGNAL_DUR
+#define SIGNAL_DUR 180 //sec
+#endif
+#ifndef PULSE_LENGTH
+#define PULSE_LENGTH 200 //ms
+#endif
+#ifndef SIGNAL_PITCH
+#define SIGNAL_PITCH 1760 //Hz – piezo
+#endif
+#ifndef SIGNAL_BEEP_LENGTH
+#define SIGNAL_BEEP_LENGTH 500 //ms – piezo
+#endif
+#define SIGNAL_PIN (TIMER_SIGNAL==0? PIEZO_PIN: (TIMER_SIGNAL==1? SWITCH_PIN: PULSE_PIN))
+#define SIGNAL_ON_MS (TIMER_SIGNAL==0? SIGNAL_BEEP_LENGTH: PULSE_LENGTH) //of each second
+#define SIG_ARM_MS 1000 //how far ahead a deadline is armed – more than TASK_IDLE_MS, so taskTimer always gets to it in time
+
+unsigned long long sigStart = 0; //ms() deadline the current signal started at
+word sigBeeps = 0; //how many beeps/pulses the signal has, one per second from sigStart – 0 when not signalling
+bool sigOut = 0; //whether cycleSignal has the output on
+
+volatile byte sigState = 0; //the armed deadline: 0 = none, 1 = armed, 2 = fired (output started), yet to be taken by timerRunout
+volatile byte sigCh = 0; //the channel whose deadline is armed
+bool sigClaim(byte from, byte to){ //"private"
+  //Moves sigState from one state to another, if it's in that state – atomically, since the deadline interrupt does too. Returns whether it did.
+  #ifdef ESP32
+    return __atomic_compare_exchange_n(&sigState,&from,to,false,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE);
+  #else
+    noInterrupts(); bool ok = (sigState==from); if(ok) sigState = to; interrupts();
+    return ok;
+  #endif
+}
+
+bool sigTake(byte c){ //"private"
+  //For timerRunout: disarms channel c's deadline if it hasn't fired yet – else takes it. Returns whether it had fired.
+  if(sigCh!=c || sigClaim(1,0)) return 0;
+  return sigClaim(2,0);
+}
+
+void signalOn(byte c){ //"private"
+  //Starts the output, at the deadline of channel c – from the deadline interrupt, or timerRunout if that didn't get there first
+  if(SIGNAL_PIN<0) return;
+  #if TIMER_SIGNAL==0
+    tone(SIGNAL_PIN,SIGNAL_PITCH);
+  #elif TIMER_SIGNAL==1
+    if(!(timerState[c]&4)) digitalWrite(SIGNAL_PIN,LOW); //unless it starts over, in which case it's still running
+  #else
+    digitalWrite(SIGNAL_PIN,HIGH);
+  #endif
+}
+void signalOff(){ //"private"
+  if(SIGNAL_PIN<0) return;
+  #if TIMER_SIGNAL==0
+    noTone(SIGNAL_PIN);
+  #elif TIMER_SIGNAL==2
+    digitalWrite(SIGNAL_PIN,LOW);
+  #endif
+}
+void signalStart(unsigned long long at, bool quick){
+  //Carries on the signal that started at deadline at (ms()): for SIGNAL_DUR, or one beep/pulse if quick
+  #if TIMER_SIGNAL!=1
+  sigStart = at; sigBeeps = (quick? 1: SIGNAL_DUR); sigOut = 1;
+  #endif
+}
+void signalStop(){
+  if(!sigBeeps) return;
+  sigBeeps = 0; sigOut = 0; signalOff();
+}
+bool signalBusy(){ return sigBeeps; }
+void cycleSignal(){
+  //Called by taskTimer: turns the output on for the first SIGNAL_ON_MS of each second since the deadline, until sigBeeps are done
+  if(!sigBeeps) return;
+  unsigned long el = ms()-sigStart;
+  if(el/1000>=sigBeeps){ signalStop(); return; }
+  bool on = (el%1000<SIGNAL_ON_MS);
+  if(on==sigOut) return;
+  sigOut = on;
+  if(on) signalOn(sigCh); else signalOff();
+}
+void signalSwitch(){ //"private"
+  //The switch output (TIMER_SIGNAL 1) is on while any countdown is running
+  #if TIMER_SIGNAL==1
+  if(SIGNAL_PIN<0) return;
+  bool on = 0;
+  for(byte c=0; c<TIMER_CHANNELS; c++) if(bitRead(timerRunning,c) && !((timerState[c]>>1)&1)) on = 1;
+  digitalWrite(SIGNAL_PIN,on);
+  #endif
+}
+
+#if defined(__AVR__)
+  //On AVR, the deadline is taken by Timer0's compare B interrupt (so pin 5 can't be used for PWM). Timer0 already runs millis(),
+  //cycling every 1.024ms (at 16MHz), so while armed, the interrupt checks each cycle, and on the last cycle before the deadline,
+  //moves the compare to it exactly.
+  #define SIG_US_PER_COUNT (64/(F_CPU/1000000L)) //Timer0 counts at F_CPU/64 – 4µs at 16MHz
+  volatile unsigned long sigAt = 0; //micros() at the deadline
+  ISR(TIMER0_COMPB_vect){
+    long rem = sigAt-micros();
+    if(rem>0){
+      if(rem<256L*SIG_US_PER_COUNT){ byte n = rem/SIG_US_PER_COUNT; OCR0B = TCNT0+(n? n: 1); }
+      return;
+    }
+    TIMSK0 &= ~_BV(OCIE0B);
+    if(sigState==1){ sigState = 2; signalOn(sigCh); }
+  }
+#elif defined(ESP32)
+  //On ESP32, the deadline is an esp_timer one-shot
+  #include <esp_timer.h>
+  esp_timer_handle_t sigTimer;
+  void sigTimerFire(void *arg){ //"private"
+    if(sigClaim(1,2)) signalOn(sigCh);
+  }
+#endif
+void sigArm(){ //"private"
+  //Arms the deadline of the soonest running countdown, once it's within SIG_ARM_MS. Called by taskTimer, and when timers start/stop.
+  //It's rearmed each time, from ms(), so the deadline is always as per its latest rate correction. (Elsewhere, timerRunout does it all.)
+  #if defined(__AVR__) || defined(ESP32)
+  if(SIGNAL_PIN<0) return; //nothing to signal on time
+  if(sigState==2) return; //the last deadline is yet to be taken by timerRunout
+  unsigned long long now = ms(); unsigned long long at = 0;
+  byte c, cs = 255;
+  for(c=0; c<TIMER_CHANNELS; c++){
+    if(!bitRead(timerRunning,c) || ((timerState[c]>>1)&1) || timerTime[c]<=now) continue; //only countdowns not yet due
+    if(cs==255 || timerTime[c]<at){ at = timerTime[c]; cs = c; }
+  }
+  if(!sigClaim(1,0) && sigState==2) return; //disarm – unless it just fired
+  #ifdef __AVR__
+    TIMSK0 &= ~_BV(OCIE0B);
+  #else
+    esp_timer_stop(sigTimer);
+  #endif
+  if(cs==255 || at-now>SIG_ARM_MS) return;
+  long long us = (at-now)*1000;
+  #ifndef TIMEBASE_32K
+    us -= (us*millisRate)>>24; //ms() runs at millis() plus the rate correction, so in real time the deadline is that much sooner or later
+  #endif
+  sigCh = cs; sigState = 1;
+  #ifdef __AVR__
+    sigAt = micros()+us;
+    OCR0B = TCNT0+1; TIFR0 = _BV(OCF0B); TIMSK0 |= _BV(OCIE0B);
+  #else
+    esp_timer_start_once(sigTimer,us);
+  #endif
+  #endif
+}
+
 void initOutputs() {
+  #if TIMER_SIGNAL!=0
+    if(SIGNAL_PIN>=0){ pinMode(SIGNAL_PIN,OUTPUT); digitalWrite(SIGNAL_PIN,LOW); } //(tone() sets up the piezo pin)
+  #endif
+  #ifdef ESP32
+    esp_timer_create_args_t args = {};
+    args.callback = sigTimerFire; args.name = "sig"; //dispatched from the esp_timer task
+    esp_timer_create(&args,&sigTimer);
+  #endif
 }
\ No newline at end of file
@@ -39,6 +39,19 @@
 //Requires Wire library (standard Arduino)
 //Requires DS3231 library by NorthernWidget to be installed in your IDE.
 #define RTC_DS3231
+//If the DS3231's SQW output is connected to an interrupt-capable pin, the RTC is only read once per second, on its tick:
+// #define RTC_SQW_PIN 2
+//If the DS3231's 32K output is connected, the chrono counts it (via PCNT) instead of using millis() – no drift correction needed:
+// #define TIMEBASE_32K
+// #define TIMEBASE_32K_PIN 4 //avoid strapping pins (0, 2, 12, 15), since the DS3231 outputs 32kHz from power-on
+//To checkpoint timer state to EEPROM on start/stop/clear, and restore it after a power cut (running timers need a real RTC to carry on running):
+// #define PERSIST_STATE
+//To stream timer events as binary records over serial (decode with tools/telemetry_decode.py). 1 = timer events, 2 = also clock drift corrections. Not with SHOW_SERIAL:
+// #define TELEMETRY_LEVEL 1
+//To time each task and press-to-event latency, and dump the stats over telemetry on a long hold of Alt (needs TELEMETRY_LEVEL):
+// #define ENABLE_PROFILER
+//On dual-core ESP32s, to run the I2C work (display, RTC) in its own task on core 0, so input and timing on core 1 never wait on it:
+// #define ESP32_DUAL_CORE
 
 
 ///// Inputs /////
@@ -55,6 +68,13 @@
 #define CTRL_UP A2
 #define CTRL_DN A3
 
+//If using a rotary encoder for Up and Down – its A and B pins, decoded by the ESP32's pulse counter:
+// #define INPUT_UPDN_ROTARY
+// #define CTRL_UP 25
+// #define CTRL_DN 26
+// #define ROT_ACCEL_MAX 10 //the most steps a detent counts for, when turned quickly (see checkRot)
+// #define ROT_PCNT_UNIT PCNT_UNIT_1 //the pulse counter unit it uses – must differ from TB_PCNT_UNIT (unit 0), if using TIMEBASE_32K
+
 //For all input types:
 //How long (in ms) are the hold durations?
 #define CTRL_HOLD_SHORT_DUR 1000 //for entering setting mode, or hold-setting at low velocity (x1)
@@ -66,6 +86,8 @@
 #define FN_TEMP_TIMEOUT 5 //sec
 #define FN_PAGE_TIMEOUT 3 //sec
 #define STOPWATCH_TIMEOUT 10
+// #define IDLE_SLEEP //once cleared and left alone for STOPWATCH_TIMEOUT, sleep with the display off until Sel is pressed (which also starts the timer) – for battery power. Sel must be on a digital pin. AVR (power-down) and ESP32 (light sleep) only
+// #define TIMER_COUNTDOWN 300 //sec – to count down from this rather than up from zero. At zero, it signals (per TIMER_SIGNAL), and then per TIMER_RUNOUT: 0 = stops, 4 = starts over, 8 = carries on counting up
 
 
 ///// Outputs /////
@@ -105,7 +127,7 @@
 
 ///// Ambient Light Sensor /////
 //If using VEML 7700 Lux sensor (I2C on SDA/SCL pins)
-//Requires Adafruit library VEML7700
+//Read directly by register – no library needed. See lightVEML7700.cpp for sampling and smoothing options.
 #define LIGHTSENSOR_VEML7700
 #define LUX_FULL 400 //lux at/above which display should be at its brightest (per config)
 #define LUX_DIM 30 //lux at/below which display should be at its dimmest (per config)
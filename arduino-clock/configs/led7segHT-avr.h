@@ -8,6 +8,12 @@
 //If using no RTC (a fake RTC based on millis()):
 #define RTC_MILLIS
 #define ANTI_DRIFT 0 //msec to add/remove per second - or seconds to add/remove per day divided by 86.4 - to compensate for natural drift. If using wifinina, it really only needs to be good enough for a decent timekeeping display until the next ntp sync. TIP: setting to a superhigh value is helpful for testing! e.g. 9000 will make it run 10x speed
+//To checkpoint timer state to EEPROM on start/stop/clear, and restore it after a power cut (running timers need a real RTC to carry on running):
+// #define PERSIST_STATE
+//To stream timer events as binary records over serial (decode with tools/telemetry_decode.py). 1 = timer events, 2 = also clock drift corrections. Not with SHOW_SERIAL:
+// #define TELEMETRY_LEVEL 1
+//To time each task and press-to-event latency, and dump the stats over telemetry on a long hold of Alt (needs TELEMETRY_LEVEL):
+// #define ENABLE_PROFILER
 
 
 ///// Inputs /////
@@ -28,6 +34,9 @@
 #define CTRL_HOLD_SUPERLONG_DUR 10000 //for wifi disconnect (Nano IoT) or EEPROM reset on startup
 //What are the timeouts for setting and temporarily-displayed functions? up to 65535 sec
 #define STOPWATCH_TIMEOUT 10
+// #define IDLE_SLEEP //once cleared and left alone for STOPWATCH_TIMEOUT, sleep with the display off until Sel is pressed (which also starts the timer) – for battery power. Sel must be on a digital pin. AVR (power-down) and ESP32 (light sleep) only
+// #define TIMER_COUNTDOWN 300 //sec – to count down from this rather than up from zero. At zero, it signals (per TIMER_SIGNAL), and then per TIMER_RUNOUT: 0 = stops, 4 = starts over, 8 = carries on counting up
+// #define TIMER_SIGNAL 0 //0 = beep on PIEZO_PIN, 1 = switch SWITCH_PIN off (it is on while counting down), 2 = pulse PULSE_PIN
 
 
 ///// Display /////
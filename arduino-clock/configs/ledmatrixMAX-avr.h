@@ -33,6 +33,9 @@
 #define CTRL_HOLD_SUPERLONG_DUR 10000 //for wifi disconnect (Nano IoT) or EEPROM reset on startup
 //What are the timeouts for setting and temporarily-displayed functions? up to 65535 sec
 #define STOPWATCH_TIMEOUT 10
+// #define IDLE_SLEEP //once cleared and left alone for STOPWATCH_TIMEOUT, sleep with the display off until Sel is pressed (which also starts the timer) – for battery power. Sel must be on a digital pin. AVR (power-down) and ESP32 (light sleep) only
+// #define TIMER_COUNTDOWN 300 //sec – to count down from this rather than up from zero. At zero, it signals (per TIMER_SIGNAL), and then per TIMER_RUNOUT: 0 = stops, 4 = starts over, 8 = carries on counting up
+// #define TIMER_SIGNAL 0 //0 = beep on PIEZO_PIN, 1 = switch SWITCH_PIN off (it is on while counting down), 2 = pulse PULSE_PIN
 
 
 ///// Display /////
@@ -48,7 +51,7 @@
 // #define DISPLAY_ADDR 0x70 //0x70 is the default
 
 //If using 8x32 LED matrix:
-//Requires LedControl library by Eberhard Farle to be installed in IDE. (http://wayoda.github.io/LedControl)
+//Requires SPI library (standard Arduino). Uses hardware SPI if DIN_PIN/CLK_PIN are the board's MOSI/SCK pins, else bit-bangs.
 #define DISPLAY_MAX7219
 #define NUM_MAX 4 //How many modules? 3 for 8x24 (4 digit, untested) or 4 for 8x32 (6 digit)
 #define ROTATE 90
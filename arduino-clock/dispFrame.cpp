@@ -0,0 +1,35 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#if defined(DISPLAY_MAX7219) || defined(DISPLAY_HT16K33) //see arduino-clock.ino Includes section
+
+#include "dispFrame.h"
+#include "dispMAX7219.h" //each defines DispBackend, if it's the disp option in use
+#include "dispHT16K33.h"
+
+DispBackend dispHw; //the display, per the disp option in use
+
+void initDisplay(){
+  dispHw.init();
+  //initial brightness will be set at first cycleDisplay
+}
+void displayPublish(){ dispHw.publish(); }
+const byte *displayFrame(){ return dispHw.frame(); } //"private"
+void commitDisplay(){ dispHw.commit(); } //"private"
+void invalidateDisplay(){ dispHw.invalidate(); } //"private"
+void cycleDisplay(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg){
+  dispHw.cycle(displayBrightness,useAmbient,ambientLightLevel,fnSetPg);
+}
+void editDisplay(word n, byte posStart, byte posEnd, bool leadingZeros, bool fade){
+  dispHw.edit(n,posStart,posEnd,leadingZeros);
+}
+void editDisplayPair(byte tens, byte ones, byte posStart, bool leadingZeros, bool fade){
+  dispHw.editPair(tens,ones,posStart,leadingZeros);
+}
+void blankDisplay(byte posStart, byte posEnd, byte fade){
+  dispHw.blank(posStart,posEnd);
+}
+void displayBlink(){ dispHw.blink(); }
+void displayStandby(bool on){ dispHw.standby(on); }
+
+#endif
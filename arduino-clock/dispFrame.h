@@ -0,0 +1,187 @@
+#ifndef DISPLAY_FRAME_H
+#define DISPLAY_FRAME_H
+
+//The display API, whichever disp option is in use – defined in dispFrame.cpp, over that option's backend
+
+void initDisplay();
+void displayPublish();
+const byte *displayFrame();
+void commitDisplay();
+void invalidateDisplay();
+void cycleDisplay(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg);
+void editDisplay(word n, byte posStart, byte posEnd, bool leadingZeros, bool fade);
+void editDisplayPair(byte tens, byte ones, byte posStart, bool leadingZeros, bool fade);
+void blankDisplay(byte posStart, byte posEnd, byte fade);
+void displayBlink();
+void displayStandby(bool on);
+
+#include "frameMailbox.h" //for ESP32_DUAL_CORE
+
+//these can be overridden in your config .h
+#ifndef BRIGHTNESS_FULL
+#define BRIGHTNESS_FULL 15 //out of 0-15
+#endif
+#ifndef BRIGHTNESS_DIM
+#define BRIGHTNESS_DIM 0
+#endif
+
+//The frame layer: everything about the display that isn't the hardware – the staged digits, diffing them against what was sent,
+//and the brightness and blink states. A backend derives from DispFrame<itself> (CRTP), and provides the hardware side:
+//  void init()
+//  bool commitRows(const byte *frame, byte rows, bool force) – sends the digits of frame whose bits are set in rows (bit per position).
+//    Returns whether it did – it may decline if it's not its turn on the bus, unless forced.
+//  void setIntensity(byte b) – per BRIGHTNESS_DIM-BRIGHTNESS_FULL
+//  void standby(bool on)
+//The calls are resolved at compile time, so there are no virtual calls.
+template<class Backend> class DispFrame {
+  byte next[6] = {15,15,15,15,15,15}; //Internal representation of display. Blank to start.
+  byte sent[6] = {255,255,255,255,255,255}; //What was last committed to the backend. 255 (never a valid digit) forces a write.
+  #ifdef ESP32_DUAL_CORE
+    //Frames are staged in next by the main code, on core 1, and committed by the bus task, on core 0 – so they're passed over via a mailbox
+    FrameMailbox<6> mail = FrameMailbox<6>(15);
+  #endif
+  byte curBrightness = 255; //represents current display normal/dim/off state – compare to displayBrightness as passed to cycle. Start at 255 to force an adjustment at startup
+  #ifdef LIGHTSENSOR
+  byte curAmbientBrightness = 255; //represents the brightness last set per ambient light level – so it's only set again when that changes. Start at 255 to force it
+  #endif
+  unsigned long blinkStart = 0; //when nonzero, display should briefly blank
+  unsigned long setStartLast = 0; //to control flashing during start
+  bool setBlinkState = 0;
+  
+  Backend &hw(){ return *static_cast<Backend*>(this); }
+  void dark(){
+    //Blanks the display hardware, regardless of the staged frame
+    static const byte blank[6] = {15,15,15,15,15,15};
+    hw().commitRows(blank,(1<<DISPLAY_SIZE)-1,1);
+  }
+  
+public:
+  void publish(){
+    //Called by the main code when it has finished staging a frame in next. On ESP32_DUAL_CORE, hands it over to commit.
+    #ifdef ESP32_DUAL_CORE
+      memcpy(mail.frame(),next,6); mail.publish();
+    #endif
+  }
+  const byte *frame(){
+    //The frame for commit to commit: the latest published, or on a single core, simply next
+    #ifdef ESP32_DUAL_CORE
+      return mail.latest();
+    #else
+      return next;
+    #endif
+  }
+  
+  void commit(){
+    //Called once per loop by cycle. edit and blank only stage digits in next;
+    //here we compare that to sent, and have the backend send only the digits that have changed.
+    const byte *f = frame();
+    byte rows = 0;
+    for(byte i=0; i<DISPLAY_SIZE; i++) if(f[i]!=sent[i]) rows |= 1<<i;
+    if(!rows) return; //nothing has changed
+    if(!hw().commitRows(f,rows,0)) return; //not sent – try again next pass
+    for(byte i=0; i<DISPLAY_SIZE; i++) sent[i] = f[i];
+  }
+  
+  void invalidate(){
+    //Forces the next commit to write every digit, e.g. after something else has written to the display
+    for(byte i=0; i<6; i++) sent[i] = 255;
+  }
+  
+  void cycle(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg){
+    unsigned long now = millis();
+    //The display hardware handles its own multiplexing - just needs display data updates.
+    //But we do need to check if the blink should be over, and whether brightness has changed (or should change, per setting).
+    
+    //If we're in the middle of a blink, see if it's time to end it
+    if(blinkStart){
+      if((unsigned long)(now-blinkStart)>=500){ blinkStart = 0; invalidate(); }
+    }
+    
+    //Check if it's time to change brightness - either due to setting flashing or change in displayBrightness/ambientLightLevel inputs
+    if(fnSetPg>0) { //setting - dim for every other 500ms - using the brightest and dimmest states of the display (TODO too crude?)
+      if(setStartLast==0) {
+        setStartLast = now;
+        setBlinkState = 1;
+        //When starting, if we're using ambient at less than 2/3 brightness, set curBrightness to dim, so we'll start bright
+        if(useAmbient && ambientLightLevel<170) curBrightness = 1;
+      }
+      bool blinkModulus = ((unsigned long)(now-setStartLast)/500)%2;
+      if(setBlinkState!=blinkModulus) { //will occur every 500ms
+        setBlinkState = blinkModulus;
+        //If we were dim at start (curBrightness), invert setBlinkState to "start" at 1
+        hw().setIntensity(((curBrightness==1?1:0)-setBlinkState)? BRIGHTNESS_FULL: BRIGHTNESS_DIM);
+      }
+    }
+    
+    else { //not setting - defer to what other code has set displayBrightness to (and ambientLightLevel if applicable)
+  #ifdef LIGHTSENSOR
+      //if using ambient lighting at normal brightness, and: the brightness it calls for has changed, or if returning from setting, or if brightness normality has changed
+      if(useAmbient && displayBrightness==2) { //otherwise see below code
+        //Convert the ambient light level (0-255, per LUX_DIM-LUX_FULL) to the corresponding brightness value for the actual display hardware, within the desired range (BRIGHTNESS_DIM-BRIGHTNESS_FULL).
+        //Several levels can call for the same brightness, so compare that, rather than the level, to avoid rewriting it.
+        byte b = BRIGHTNESS_DIM + ((long)ambientLightLevel * (BRIGHTNESS_FULL - BRIGHTNESS_DIM) /255);
+        if(curAmbientBrightness != b || setStartLast>0 || curBrightness != displayBrightness) {
+          curAmbientBrightness = b;
+          hw().setIntensity(b);
+        }
+      }
+  #endif
+      //if returning from setting, or if brightness normality has changed
+      if(setStartLast>0 || curBrightness != displayBrightness) {
+        curBrightness = displayBrightness;
+        if(curBrightness==0) { dark(); for(byte i=0; i<6; i++) sent[i] = 15; } //force dark
+        if(curBrightness==1) hw().setIntensity(BRIGHTNESS_DIM);
+        if(curBrightness==2) { //normal brightness - only set if no light sensor, or not using light sensor
+  #ifdef LIGHTSENSOR
+          if(!useAmbient) hw().setIntensity(BRIGHTNESS_FULL);
+  #else
+          hw().setIntensity(BRIGHTNESS_FULL);
+  #endif
+        }
+      }
+      if(setStartLast>0) setStartLast=0; //remove setting flag if needed
+    } //end if not setting
+    
+    //Finally, send any digits that have changed since last time – unless we're in the middle of a blink
+    if(!blinkStart) commit();
+    
+  } //end cycle
+  
+  void edit(word n, byte posStart, byte posEnd, bool leadingZeros){
+    //Splits n into digits, sets them into next in places posSt-posEnd (inclusive), with or without leading zeros
+    //If there are blank places (on the left of a non-leading-zero number), uses value 15 to blank the digit
+    //If number has more places than posEnd-posStart, the higher places are truncated off (e.g. 10015 on 4-digit displays --> 0015)
+    unsigned long place; //wider than n, so place 5 (100000) fits
+    for(byte i=0; i<=posEnd-posStart; i++){
+      switch(i){ //because int(pow(10,1))==10 but int(pow(10,2))==99...
+        case 0: place=1; break;
+        case 1: place=10; break;
+        case 2: place=100; break;
+        case 3: place=1000; break;
+        case 4: place=10000; break;
+        case 5: place=100000; break;
+        default: break;
+      }
+      next[posEnd-i] = (i==0&&n==0 ? 0 : (n>=place ? (n/place)%10 : (leadingZeros?0:15)));
+    }
+    //cycle will commit the changed digits
+  }
+  void editPair(byte tens, byte ones, byte posStart, bool leadingZeros){
+    //Like edit, for a two-digit value that is already broken down into digits (e.g. by the timer formatter), so needs no division
+    next[posStart] = (tens==0&&!leadingZeros? 15: tens);
+    next[posStart+1] = ones;
+    //cycle will commit the changed digits
+  }
+  void blank(byte posStart, byte posEnd){
+    for(byte i=posStart; i<=posEnd; i++) { next[i]=15; }
+    //cycle will commit the changed digits
+  }
+  
+  void blink(){
+    //cycle holds off committing until the blink is over, then rewrites everything
+    dark();
+    blinkStart = millis();
+  }
+};
+
+#endif //DISPLAY_FRAME_H
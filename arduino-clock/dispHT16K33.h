@@ -3,11 +3,17 @@
 
 //Mutually exclusive with other disp options
 
-void initDisplay();
-void sendToHT16K33(byte posStart, byte posEnd);
-void cycleDisplay(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg);
-void editDisplay(word n, byte posStart, byte posEnd, bool leadingZeros, bool fade);
-void blankDisplay(byte posStart, byte posEnd, byte fade);
-void displayBlink();
-
-#endif //DISPLAY_HT16K33
\ No newline at end of file
+#include "dispFrame.h"
+
+#ifdef DISPLAY_HT16K33
+class DispHT16K33 : public DispFrame<DispHT16K33> { //see dispFrame.h
+public:
+  void init();
+  bool commitRows(const byte *frame, byte rows, bool force);
+  void setIntensity(byte b);
+  void standby(bool on);
+};
+typedef DispHT16K33 DispBackend;
+#endif
+
+#endif //DISPLAY_HT16K33
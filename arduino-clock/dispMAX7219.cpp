@@ -1,39 +1,76 @@
-#include <arduino.h>
+#include <Arduino.h>
 #include "arduino-clock.h"
 
 #ifdef DISPLAY_MAX7219 //see arduino-clock.ino Includes section
 
 #include "dispMAX7219.h"
+#include "profiler.h" //for bus byte counts, if ENABLE_PROFILER
 #include <SPI.h> //Arduino - for SPI access to MAX7219
-#include <LedControl.h> //Eberhard Farle's LedControl library - http://wayoda.github.io/LedControl
 
-LedControl lc=LedControl(DIN_PIN,CLK_PIN,CS_PIN,NUM_MAX);
-
-//these can be overridden in your config .h
-#ifndef BRIGHTNESS_FULL
-#define BRIGHTNESS_FULL 15 //out of 0-15
-#endif
-#ifndef BRIGHTNESS_DIM
-#define BRIGHTNESS_DIM 0
-#endif
-
-byte curBrightness = 255; //represents current display normal/dim/off state – compare to displayBrightness as passed to cycleDisplay. Start at 255 to force an adjustment at startup
-#ifdef LIGHTSENSOR
-word curAmbientLightLevel = 0; //represents current ambient light level reading (as tweened by main code)
-#endif
-
-unsigned long displayBlinkStart = 0; //when nonzero, display should briefly blank
-
-void initDisplay(){
-  for(int i=0; i<NUM_MAX; i++) {
-    lc.shutdown(i,false);
-    //lc.setIntensity(i,curBrightness);
+//The backend for dispFrame.h, which stages the digits and handles brightness and blinks
+
+//MAX7219 driver
+//Rather than setting one LED column at a time (which, via LedControl, shifts the entire chain once per LED row),
+//we keep a framebuffer of every chip's row registers, and send only the rows that have changed –
+//each row to every chip in the chain in a single latch (one CS toggle per row).
+#define MAX_REG_DIGIT0 0x01 //row registers are 0x01-0x08
+#define MAX_REG_DECODE 0x09
+#define MAX_REG_INTENSITY 0x0A
+#define MAX_REG_SCANLIMIT 0x0B
+#define MAX_REG_SHUTDOWN 0x0C
+#define MAX_REG_TEST 0x0F
+const bool maxHwSpi = (DIN_PIN==MOSI && CLK_PIN==SCK); //if the config uses the hardware SPI pins, use hardware SPI; else bit-bang
+byte fb[NUM_MAX*8]; //framebuffer: row registers for each chip, at [chip*8+row]. Bit n of each row is column n of that chip, counting from the left (see Layout).
+byte fbDirty = 0; //bitmask of rows that have changed since last sent
+
+void maxShift(byte b){ //"private"
+  if(maxHwSpi) SPI.transfer(b);
+  else shiftOut(DIN_PIN,CLK_PIN,MSBFIRST,b);
+}
+void maxLatchStart(){ //"private"
+  if(maxHwSpi) SPI.beginTransaction(SPISettings(8000000,MSBFIRST,SPI_MODE0)); //MAX7219 can take up to 10MHz
+  digitalWrite(CS_PIN,LOW);
+}
+void maxLatchEnd(){ //"private"
+  digitalWrite(CS_PIN,HIGH); //MAX7219 latches on CS rising edge
+  if(maxHwSpi) SPI.endTransaction();
+}
+void maxSendAll(byte reg, byte val){ //"private"
+  //Sets the same register to the same value on every chip in the chain, in one latch
+  maxLatchStart();
+  for(byte i=0; i<NUM_MAX; i++) { maxShift(reg); maxShift(val); }
+  maxLatchEnd();
+}
+void fbClear(){ //"private"
+  for(byte i=0; i<NUM_MAX*8; i++) fb[i] = 0;
+  fbDirty = 0xFF;
+}
+void fbSend(){ //"private"
+  //Sends each dirty row of the framebuffer to every chip in the chain, in one latch per row
+  for(byte r=0; r<8; r++){
+    if(!(fbDirty&(1<<r))) continue;
+    maxLatchStart();
+    for(byte i=NUM_MAX; i>0; i--) { maxShift(MAX_REG_DIGIT0+r); maxShift(fb[(i-1)*8+r]); } //last chip in the chain goes out first
+    maxLatchEnd();
   }
+  fbDirty = 0;
+}
+
+void DispMAX7219::init(){
+  pinMode(CS_PIN,OUTPUT); digitalWrite(CS_PIN,HIGH);
+  if(maxHwSpi) SPI.begin();
+  else { pinMode(DIN_PIN,OUTPUT); pinMode(CLK_PIN,OUTPUT); }
+  maxSendAll(MAX_REG_TEST,0);
+  maxSendAll(MAX_REG_SCANLIMIT,7); //all 8 rows
+  maxSendAll(MAX_REG_DECODE,0); //raw segments, no BCD decode
+  fbClear(); fbSend();
+  maxSendAll(MAX_REG_SHUTDOWN,1); //normal operation
 }
 
-//TODO can we move this into flash with e.g. PROGMEM? or does that happen already?
-const char bignumWidth = 5;
-byte bignum[50]={ //First four digits - chicagolike 5x8
+//Fonts
+//These are defined as columns (MSB at top), but only used at compile time, to generate glyphSlices below.
+constexpr byte bignumWidth = 5;
+constexpr byte bignumCols[50]={ //First four digits - chicagolike 5x8
   B01111110, B11111111, B10000001, B11111111, B01111110, // 0
   B00000000, B00000100, B11111110, B11111111, B00000000, // 1
   B11000010, B11100001, B10110001, B10011111, B10001110, // 2
@@ -47,8 +84,8 @@ byte bignum[50]={ //First four digits - chicagolike 5x8
   B00001110, B10011111, B10010001, B11111111, B01111110  // 9 more squared tail
 //B00001110, B10011111, B11010001, B01111111, B00111110  // 9 original
 };
-const char smallnumWidth = 3;
-byte smallnum[30]={ //Last two digits - 3x5
+constexpr byte smallnumWidth = 3;
+constexpr byte smallnumCols[30]={ //Last two digits - 3x5
   B11111000, B10001000, B11111000, // 0
   B00010000, B11111000, B00000000, // 1 serif
   B11101000, B10101000, B10111000, // 2
@@ -61,129 +98,71 @@ byte smallnum[30]={ //Last two digits - 3x5
   B10111000, B10101000, B11111000  // 9
 };
 
-byte displayNext[6] = {15,15,15,15,15,15}; //Internal representation of display. Blank to start.
-
-void sendToMAX7219(byte posStart, byte posEnd){ //"private"
-  //Called by editDisplay and blankDisplay. Needed in lieu of what cycleDisplay does for nixies.
-  byte col = 0; //column to start updating, 0 at left
-  byte val = 0; //byte to send to the LED column
-  byte ci = 0;
-  for(byte i=posStart; i<=posEnd; i++){
-    if(i>3 && (NUM_MAX<=3 || DISPLAY_SIZE<6)) return; //if 3 or fewer matrices, don't render digits 4 and 5
-    col = //h tens at far left
-          (i>0? bignumWidth+1: 0)+ //h ones
-          (i>1? bignumWidth+2: 0)+ //m tens
-          (i>2? bignumWidth+1: 0)+ //m ones
-          (i>3? bignumWidth+1: 0)+ //s tens
-          (i>4? smallnumWidth+1: 0); //s ones
-    for(int j=0; j<(i<4? bignumWidth: smallnumWidth); j++){ //For each column of this number
-      ci = ((NUM_MAX*8)-1)-(col+j); //translate from our column count to MAX's column count
-      lc.setColumn(
-        (NUM_MAX-1)-(ci/8), //display index
-        ci%8, //display column index
-        (displayNext[i]==15?0:
-          (i<4? bignum[displayNext[i]*bignumWidth+j]: smallnum[displayNext[i]*smallnumWidth+j])
-        )
-      );
-    }
-  }
+//Layout
+//Since the framebuffer is stored as rows, a digit is drawn as 8 row slices. For each digit position, these tables
+//give the chip it starts on, and each glyph pre-rotated into rows and shifted into place across that chip and the next,
+//so drawing a digit is just table lookups. These are all computed at compile time and stored in flash.
+constexpr byte digitWidth(byte i){ return (i<4? bignumWidth: smallnumWidth); }
+constexpr byte digitCol(byte i){ //column where digit position i starts, 0 at left – h tens at far left
+  return (i==0? 0: digitCol(i-1)+digitWidth(i-1)+(i==2? 2: 1)); //one column between digits, two between h and m
 }
-
-unsigned long setStartLast = 0; //to control flashing during start
-bool setBlinkState = 0;
-void cycleDisplay(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg){
-  unsigned long now = millis();
-  //MAX7219 handles its own cycling - just needs display data updates.
-  //But we do need to check if the blink should be over, and whether brightness has changed (or should change, per setting).
-  
-  //If we're in the middle of a blink, see if it's time to end it
-  if(displayBlinkStart){
-    if((unsigned long)(now-displayBlinkStart)>=500){ displayBlinkStart = 0; sendToHT16K33(0,5); }
-  }
-  
-  //Check if it's time to change brightness - either due to setting flashing or change in displayBrightness/ambientLightLevel inputs
-  if(fnSetPg>0) { //setting - dim for every other 500ms - using the brightest and dimmest states of the display (TODO too crude?)
-    if(setStartLast==0) {
-      setStartLast = now;
-      setBlinkState = 1;
-      //When starting, if we're using ambient at less than 2/3 brightness, set curBrightness to dim, so we'll start bright
-      if(useAmbient && ambientLightLevel<170) curBrightness = 1;
-    }
-    bool blinkModulus = ((unsigned long)(now-setStartLast)/500)%2;
-    if(setBlinkState!=blinkModulus) { //will occur every 500ms
-      setBlinkState = blinkModulus;
-      //If we were dim at start (curBrightness), invert setBlinkState to "start" at 1
-      for(int i=0; i<NUM_MAX; i++) {
-        lc.setIntensity(i,((curBrightness==1?1:0)-setBlinkState)? BRIGHTNESS_FULL: BRIGHTNESS_DIM);
-      }
-    }
-  }
-  
-  else { //not setting - defer to what other code has set displayBrightness to (and ambientLightLevel if applicable)
-#ifdef LIGHTSENSOR
-    //if using ambient lighting and: it has changed, or if returning from setting, or if brightness normality has changed
-    if(useAmbient && (curAmbientLightLevel != ambientLightLevel || setStartLast>0 || curBrightness != displayBrightness)) {
-      curAmbientLightLevel = ambientLightLevel;
-      if(displayBrightness==2) { //If currently normal brightness (so we should display per ambient light level) - otherwise see below code
-        //Convert the ambient light level (0-255, per LUX_DIM-LUX_FULL) to the corresponding brightness value for the actual display hardware, within the desired range (BRIGHTNESS_DIM-BRIGHTNESS_FULL)
-        for(int i=0; i<NUM_MAX; i++) {
-          lc.setIntensity(i,BRIGHTNESS_DIM + ((long)curAmbientLightLevel * (BRIGHTNESS_FULL - BRIGHTNESS_DIM) /255));
-        }
-      }
-    }
-#endif
-    //if brightness normality has changed
-    if(curBrightness != displayBrightness) {
-      curBrightness = displayBrightness;
-      if(curBrightness==0) for(int i=0; i<NUM_MAX; i++) { lc.clearDisplay(i); } //force dark
-      if(curBrightness==1) for(int i=0; i<NUM_MAX; i++) { lc.setIntensity(i,BRIGHTNESS_DIM); }
-      if(curBrightness==2) { //normal brightness - only set if no light sensor, or not using light sensor
-#ifdef LIGHTSENSOR
-        if(!useAmbient) for(int i=0; i<NUM_MAX; i++) { lc.setIntensity(i,BRIGHTNESS_FULL); }
-#else
-        for(int i=0; i<NUM_MAX; i++) { lc.setIntensity(i,BRIGHTNESS_FULL); }
-#endif
-      }
-    }
-    if(setStartLast>0) setStartLast=0; //remove setting flag if needed
-  } //end if not setting
-  
-} //end cycleDisplay
-
-void editDisplay(word n, byte posStart, byte posEnd, bool leadingZeros, bool fade){
-  if(curBrightness==-1) return;
-  //Splits n into digits, sets them into displayNext in places posSt-posEnd (inclusive), with or without leading zeros
-  //If there are blank places (on the left of a non-leading-zero number), uses value 15 to blank the digit
-  //If number has more places than posEnd-posStart, the higher places are truncated off (e.g. 10015 on 4-digit displays --> 0015)
-  word place;
-  for(byte i=0; i<=posEnd-posStart; i++){
-    switch(i){ //because int(pow(10,1))==10 but int(pow(10,2))==99...
-      case 0: place=1; break;
-      case 1: place=10; break;
-      case 2: place=100; break;
-      case 3: place=1000; break;
-      case 4: place=10000; break;
-      case 5: place=100000; break;
-      default: break;
+constexpr byte glyphCol(byte i, byte d, byte j){ return (i<4? bignumCols[d*bignumWidth+j]: smallnumCols[d*smallnumWidth+j]); }
+constexpr byte glyphRow(byte i, byte d, byte r, byte j){ //row r of digit d, as drawn at position i: bit j is column j of the glyph
+  return (j>=digitWidth(i)? 0: (((glyphCol(i,d,j)>>(7-r))&1)<<j) | glyphRow(i,d,r,j+1));
+}
+constexpr word glyphSlice(byte i, byte d, byte r){ return (word)glyphRow(i,d,r,0)<<(digitCol(i)&7); }
+constexpr word glyphMask(byte i){ return (word)((1<<digitWidth(i))-1)<<(digitCol(i)&7); }
+#define SLICE(i,d,r) {(byte)(glyphSlice(i,d,r)&0xFF), (byte)(glyphSlice(i,d,r)>>8)}
+#define SLICE_ROWS(i,d) {SLICE(i,d,0),SLICE(i,d,1),SLICE(i,d,2),SLICE(i,d,3),SLICE(i,d,4),SLICE(i,d,5),SLICE(i,d,6),SLICE(i,d,7)}
+#define SLICE_DIGITS(i) {SLICE_ROWS(i,0),SLICE_ROWS(i,1),SLICE_ROWS(i,2),SLICE_ROWS(i,3),SLICE_ROWS(i,4),SLICE_ROWS(i,5),SLICE_ROWS(i,6),SLICE_ROWS(i,7),SLICE_ROWS(i,8),SLICE_ROWS(i,9)}
+const byte glyphSlices[6][10][8][2] PROGMEM = { //[position][digit][row][this chip, next chip]
+  SLICE_DIGITS(0),SLICE_DIGITS(1),SLICE_DIGITS(2),SLICE_DIGITS(3),SLICE_DIGITS(4),SLICE_DIGITS(5)
+};
+#define MASK(i) {(byte)(glyphMask(i)&0xFF), (byte)(glyphMask(i)>>8)}
+const byte digitMask[6][2] PROGMEM = {MASK(0),MASK(1),MASK(2),MASK(3),MASK(4),MASK(5)}; //[position][this chip, next chip]
+const byte digitChip[6] PROGMEM = {digitCol(0)>>3,digitCol(1)>>3,digitCol(2)>>3,digitCol(3)>>3,digitCol(4)>>3,digitCol(5)>>3};
+
+void drawDigit(byte i, byte n){ //"private"
+  //Draws digit n (or blank, if >9) at position i into the framebuffer.
+  if(i>3 && (NUM_MAX<=3 || DISPLAY_SIZE<6)) return; //if 3 or fewer matrices, don't render digits 4 and 5
+  bool blank = n>9;
+  const byte *slice = glyphSlices[i][blank? 0: n][0];
+  byte mLo = pgm_read_byte(&digitMask[i][0]); byte mHi = pgm_read_byte(&digitMask[i][1]);
+  byte *row = &fb[pgm_read_byte(&digitChip[i])*8];
+  byte rnew;
+  for(byte r=0; r<8; r++){
+    rnew = (row[r]&~mLo)|(blank? 0: pgm_read_byte(slice));
+    if(rnew!=row[r]) { row[r] = rnew; fbDirty |= 1<<r; }
+    if(mHi){ //straddles into the next chip
+      rnew = (row[r+8]&~mHi)|(blank? 0: pgm_read_byte(slice+1));
+      if(rnew!=row[r+8]) { row[r+8] = rnew; fbDirty |= 1<<r; }
     }
-    displayNext[posEnd-i] = (i==0&&n==0 ? 0 : (n>=place ? (n/place)%10 : (leadingZeros?0:15)));
+    slice += 2;
   }
-  sendToMAX7219(posStart,posEnd);
-  //cycleDisplay(); //fixes brightness - can we skip this?
 }
-void blankDisplay(byte posStart, byte posEnd, byte fade){
-  for(byte i=posStart; i<=posEnd; i++) { displayNext[i]=15; }
-  sendToMAX7219(posStart,posEnd);
-  //cycleDisplay(); //fixes brightness - can we skip this?
+
+bool DispMAX7219::commitRows(const byte *frame, byte rows, bool force){
+  //Draws the digits that have changed into the framebuffer, and sends only the rows that have changed as a result.
+  for(byte i=0; i<DISPLAY_SIZE; i++) if(rows&(1<<i)) drawDigit(i,frame[i]);
+  if(!fbDirty) return 1;
+  #ifdef ENABLE_PROFILER
+    byte n = 0; for(byte r=0; r<8; r++) n += (fbDirty>>r)&1;
+    profRecord(PROF_BUS,n*NUM_MAX*2); //a register and value per chip, per row
+  #endif
+  fbSend();
+  return 1;
 }
 
-//void startScroll() {}
+void DispMAX7219::setIntensity(byte b){
+  maxSendAll(MAX_REG_INTENSITY,b);
+}
 
-void displayBlink(){
-  for(int i=0; i<NUM_MAX; i++) { lc.clearDisplay(i); }
-  displayBlinkStart = millis();
+void DispMAX7219::standby(bool on){
+  //Shuts the MAX7219s down (or back up) for idle sleep. Their registers are kept, so nothing needs resending.
+  maxSendAll(MAX_REG_SHUTDOWN,!on);
 }
 
+//void startScroll() {}
 //void checkEffects(bool force){}
 
 #endif //DISPLAY_MAX7219
\ No newline at end of file
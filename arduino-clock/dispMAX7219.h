@@ -3,11 +3,21 @@
 
 //Mutually exclusive with other disp options
 
-void initDisplay();
-void sendToMAX7219(byte posStart, byte posEnd);
-void cycleDisplay(byte displayBrightness, bool useAmbient, word ambientLightLevel, byte fnSetPg);
-void editDisplay(word n, byte posStart, byte posEnd, bool leadingZeros, bool fade);
-void blankDisplay(byte posStart, byte posEnd, byte fade);
-void displayBlink();
-
-#endif //DISPLAY_MAX7219_H
\ No newline at end of file
+#include "dispFrame.h"
+
+#ifdef DISPLAY_MAX7219
+class DispMAX7219 : public DispFrame<DispMAX7219> { //see dispFrame.h
+public:
+  void init();
+  bool commitRows(const byte *frame, byte rows, bool force);
+  void setIntensity(byte b);
+  void standby(bool on);
+};
+typedef DispMAX7219 DispBackend;
+//Glyph tables, in PROGMEM (see dispMAX7219.cpp) – declared here so the host build can read the display back through them
+extern const byte glyphSlices[6][10][8][2];
+extern const byte digitMask[6][2];
+extern const byte digitChip[6];
+#endif
+
+#endif //DISPLAY_MAX7219_H
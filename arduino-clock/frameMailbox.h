@@ -0,0 +1,24 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+//Passes display frames from one core to the other (see ESP32_DUAL_CORE), without locks: the latest frame wins.
+//It's a triple buffer – the writer fills its own buffer, then swaps it with the middle one; the reader swaps its own with the middle
+//one, if that holds a frame it hasn't seen. Each side only touches its own buffer, so neither waits, and no frame is ever torn.
+template<byte N> class FrameMailbox {
+  byte buf[3][N];
+  byte back = 0; //the writer's buffer
+  byte mid = 1; //the middle buffer – plus FRESH when it holds a frame the reader hasn't taken. Only accessed atomically.
+  byte front = 2; //the reader's buffer
+  static const byte FRESH = 4;
+public:
+  FrameMailbox(byte fill){ memset(buf,fill,sizeof(buf)); }
+  byte *frame(){ return buf[back]; } //the writer's frame, to fill in
+  void publish(){ back = __atomic_exchange_n(&mid,(byte)(back|FRESH),__ATOMIC_ACQ_REL)&3; } //hands it over
+  const byte *latest(){
+    //The reader's frame: the latest published
+    if(__atomic_load_n(&mid,__ATOMIC_ACQUIRE)&FRESH) front = __atomic_exchange_n(&mid,front,__ATOMIC_ACQ_REL)&3;
+    return buf[front];
+  }
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#include "i2cBus.h"
+
+#ifdef I2C_BUS //see arduino-clock.ino Includes section
+
+#include <Wire.h> //Arduino - GNU LPGL
+
+#ifndef I2C_CLOCK
+#define I2C_CLOCK 400000 //Fast Mode – every I2C device we support can take it (DS3231, HT16K33, VEML7700, LSM6DS3)
+#endif
+
+//The RTC, display and light sensor share one I2C bus, and each transaction blocks until it's done (about 0.2–0.8ms at 400kHz).
+//Rather than letting each module use the bus whenever its task runs – so that a pass of the task loop could wait on all of them
+//in turn – each pass gets one bus job, per priority: frame commits first, then RTC reads, then the light sensor. A job that doesn't
+//get its turn stays pending, and its task tries again next pass. So a pass waits on one transaction at most.
+//So that a job that runs every pass (e.g. polling the RTC) can't starve the others, the job that had the bus last gives way
+//to any that are waiting. (Exceptions are rare: brightness changes, and the display's standby around idle sleep.)
+byte i2cJobs = 0; //pending jobs, per I2C_ bits
+bool i2cUsed = 0; //whether a job has had the bus this pass
+byte i2cLast = 0; //the job that had the bus last
+
+void i2cInit(){
+  //Called at setup, once the modules have started the bus – since some libraries' begin() resets the clock
+  Wire.setClock(I2C_CLOCK);
+}
+void i2cPass(){
+  //Called at the start of each pass of the tasks that use the bus
+  i2cUsed = 0;
+}
+bool i2cTake(byte job){
+  //Called by a module before its transaction: returns whether it may go ahead now. If not, job is left pending, for next pass.
+  i2cJobs |= job;
+  if(i2cUsed) return 0; //the bus has had its job this pass
+  byte contenders = i2cJobs;
+  if(contenders!=i2cLast) contenders &= ~i2cLast; //the job that had it last gives way to any others
+  if(contenders&(job-1)) return 0; //a higher-priority job is waiting
+  if(!(contenders&job)) return 0; //giving way
+  i2cUsed = 1; i2cLast = job; i2cJobs &= ~job;
+  return 1;
+}
+bool i2cPending(byte job){
+  //Whether job is waiting for its turn
+  return i2cJobs&job;
+}
+
+#endif //I2C_BUS
@@ -0,0 +1,26 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+//Active if any I2C device is in use (see i2cBus.cpp)
+#if defined(DISPLAY_HT16K33) || defined(RTC_DS3231) || defined(INPUT_IMU) || defined(LIGHTSENSOR_VEML7700)
+#define I2C_BUS
+#endif
+
+//Bus jobs, in priority order – the lowest bit goes first
+#define I2C_DISPLAY 1 //display frame commit
+#define I2C_RTC 2 //RTC read
+#define I2C_LIGHT 4 //light sensor read
+
+#ifdef I2C_BUS
+void i2cInit();
+void i2cPass();
+bool i2cTake(byte job);
+bool i2cPending(byte job);
+#else
+inline void i2cInit(){}
+inline void i2cPass(){}
+inline bool i2cTake(byte job){ return 1; } //no bus to share
+inline bool i2cPending(byte job){ return 0; }
+#endif
+
+#endif
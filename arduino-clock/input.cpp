@@ -1,7 +1,8 @@
-#include <arduino.h>
+#include <Arduino.h>
 #include "arduino-clock.h"
 
 #include "input.h"
+#include "profiler.h"
 
 //Needs access to RTC timestamps
 #include "rtcDS3231.h"
@@ -14,24 +15,92 @@
 #define HOLDSET_FAST_RATE 20
 #endif
 #ifndef DEBOUNCE_DUR
-#define DEBOUNCE_DUR 150 //ms
+#define DEBOUNCE_DUR 5 //ms – how long an input's reading must hold steady, after bouncing, before its next change is taken
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR //ESP32 ISRs must be in IRAM; means nothing elsewhere
+#endif
+
+#ifdef IDLE_SLEEP
+  #if !defined(INPUT_BUTTONS)
+    #error "IDLE_SLEEP needs INPUT_BUTTONS, to wake on Sel"
+  #endif
+  #if defined(__AVR__)
+    #include <avr/sleep.h>
+  #elif defined(ESP32)
+    #include <driver/gpio.h>
+    #include <esp_sleep.h>
+  #endif
 #endif
 
 //#include "Arduino.h" //not necessary, since these get compiled as part of the main sketch
-#ifdef INPUT_UPDN_ROTARY
-  #include <Encoder.h> //Paul Stoffregen - install in your Arduino IDE
-  Encoder rot(CTRL_UP,CTRL_DN);  //TODO may need to reverse
+#if defined(INPUT_UPDN_ROTARY) && !defined(INPUT_BUTTONS)
+  #error "INPUT_UPDN_ROTARY needs INPUT_BUTTONS, for Sel/Alt"
 #endif
 #ifdef INPUT_IMU
-  #include <Arduino_LSM6DS3.h>
+  //We talk to the Nano 33 IoT's LSM6DS3 accelerometer directly by its registers, rather than through Arduino_LSM6DS3, so we can
+  //run it at a low data rate, read it only when it has a new sample (per its data-ready interrupt, or at most every IMU_SAMPLE_MS),
+  //and work in raw integers rather than floats.
+  #include <Wire.h>
+  #ifndef IMU_ADDR
+  #define IMU_ADDR 0x6A
+  #endif
+  #ifndef IMU_SAMPLE_MS
+  #define IMU_SAMPLE_MS 40 //if there's no IMU_INT_PIN – matches the 26Hz data rate
+  #endif
+  //#define IMU_INT_PIN – if the LSM6DS3's INT1 pin is connected, we only read it when it signals a new sample
+  #define IMU_REG_INT1_CTRL 0x0D
+  #define IMU_REG_CTRL1_XL 0x10
+  #define IMU_REG_CTRL2_G 0x11
+  #define IMU_REG_CTRL3_C 0x12
+  #define IMU_REG_OUTX_L_XL 0x28
+  #define IMU_1G 16384 //raw reading for 1g, at ±2g full scale
 
   int8_t imuRoll, imuPitch;
   unsigned long imuLastChange;
+  #ifdef IMU_INT_PIN
+    volatile bool imuReady = 1; //set by imuISR when a new sample is ready. Starts set, to take the first one.
+    void IRAM_ATTR imuISR(){ imuReady = 1; }
+  #else
+    unsigned long imuSampleLast = 0;
+  #endif
+
+  void imuWrite(byte reg, byte val){ //"private"
+    Wire.beginTransmission(IMU_ADDR); Wire.write(reg); Wire.write(val); Wire.endTransmission();
+  }
+  void initIMU(){ //"private"
+    Wire.begin();
+    imuWrite(IMU_REG_CTRL3_C,0x44); //BDU (so the output bytes are from the same sample), IF_INC (so we can read them in one go)
+    imuWrite(IMU_REG_CTRL1_XL,0x20); //accelerometer at 26Hz, ±2g
+    imuWrite(IMU_REG_CTRL2_G,0x00); //gyroscope off
+    #ifdef IMU_INT_PIN
+      imuWrite(IMU_REG_INT1_CTRL,0x01); //accelerometer data-ready on INT1 – high until the sample is read
+      pinMode(IMU_INT_PIN,INPUT);
+      attachInterrupt(digitalPinToInterrupt(IMU_INT_PIN),imuISR,RISING);
+    #endif
+  }
+  void imuAccel(int &x, int &y, int &z){ //"private"
+    //Reads the latest raw accelerometer sample, in one burst
+    Wire.beginTransmission(IMU_ADDR); Wire.write(IMU_REG_OUTX_L_XL); Wire.endTransmission(false);
+    Wire.requestFrom(IMU_ADDR,6);
+    x = (int16_t)(Wire.read()|(Wire.read()<<8));
+    y = (int16_t)(Wire.read()|(Wire.read()<<8));
+    z = (int16_t)(Wire.read()|(Wire.read()<<8));
+  }
 
   void readIMU(unsigned long now){
-    //IMU.readAcceleration will give us three values, but we only care about two,
+    //Only read when there's a new sample
+    #ifdef IMU_INT_PIN
+      if(!imuReady) return;
+      imuReady = 0;
+    #else
+      if((unsigned long)(now-imuSampleLast)<IMU_SAMPLE_MS) return;
+      imuSampleLast = now;
+    #endif
+    //imuAccel will give us three values, but we only care about two,
     //since we are only reading the clock being tilted left/right (roll) and back/front (pitch).
-    float roll, pitch, nah;
+    int roll, pitch, nah;
     /*
     Now we decide how to read the IMU into those values, per the orientation of the Nano:
     USB   IC     Roll Pitch
@@ -76,145 +145,381 @@
 
     #ifdef USB_DIR_UP
       #ifdef IC_DIR_FRONT //y, -z (roll, pitch)
-        IMU.readAcceleration(nah, roll, pitch); pitch = -pitch;
+        imuAccel(nah, roll, pitch); pitch = -pitch;
       #endif
       #ifdef IC_DIR_BACK //-y, z
-        IMU.readAcceleration(nah, roll, pitch); roll = -roll;
+        imuAccel(nah, roll, pitch); roll = -roll;
       #endif
       #ifdef IC_DIR_LEFT //z, y
-        IMU.readAcceleration(nah, pitch, roll);
+        imuAccel(nah, pitch, roll);
       #endif
       #ifdef IC_DIR_RIGHT //-z, -y
-        IMU.readAcceleration(nah, pitch, roll); roll = -roll; pitch = -pitch;
+        imuAccel(nah, pitch, roll); roll = -roll; pitch = -pitch;
       #endif
     #endif //USB_DIR_UP
 
     #ifdef USB_DIR_DOWN
       #ifdef IC_DIR_FRONT //-y, -z
-        IMU.readAcceleration(nah, roll, pitch); roll = -roll; pitch = -pitch;
+        imuAccel(nah, roll, pitch); roll = -roll; pitch = -pitch;
       #endif
       #ifdef IC_DIR_BACK //y, z
-        IMU.readAcceleration(nah, roll, pitch);
+        imuAccel(nah, roll, pitch);
       #endif
       #ifdef IC_DIR_LEFT //z, -y
-        IMU.readAcceleration(nah, pitch, roll); pitch = -pitch;
+        imuAccel(nah, pitch, roll); pitch = -pitch;
       #endif
       #ifdef IC_DIR_RIGHT //-z, y
-        IMU.readAcceleration(nah, pitch, roll); roll = -roll;
+        imuAccel(nah, pitch, roll); roll = -roll;
       #endif
     #endif //USB_DIR_DOWN
 
     #ifdef USB_DIR_LEFT
       #ifdef IC_DIR_FRONT //x, -z
-        IMU.readAcceleration(roll, nah, pitch); pitch = -pitch;
+        imuAccel(roll, nah, pitch); pitch = -pitch;
       #endif
       #ifdef IC_DIR_BACK //x, z
-        IMU.readAcceleration(roll, nah, pitch);
+        imuAccel(roll, nah, pitch);
       #endif
       #ifdef IC_DIR_UP //x, -y
-        IMU.readAcceleration(roll, pitch, nah); pitch = -pitch;
+        imuAccel(roll, pitch, nah); pitch = -pitch;
       #endif
       #ifdef IC_DIR_DOWN //x, y
-        IMU.readAcceleration(roll, pitch, nah);
+        imuAccel(roll, pitch, nah);
       #endif
     #endif //USB_DIR_LEFT
 
     #ifdef USB_DIR_RIGHT
       #ifdef IC_DIR_FRONT //-x, -z
-        IMU.readAcceleration(roll, nah, pitch); roll = -roll; pitch = -pitch;
+        imuAccel(roll, nah, pitch); roll = -roll; pitch = -pitch;
       #endif
       #ifdef IC_DIR_BACK //-x, z
-        IMU.readAcceleration(roll, nah, pitch); roll = -roll;
+        imuAccel(roll, nah, pitch); roll = -roll;
       #endif
       #ifdef IC_DIR_UP //-x, -y
-        IMU.readAcceleration(roll, pitch, nah); roll = -roll; pitch = -pitch;
+        imuAccel(roll, pitch, nah); roll = -roll; pitch = -pitch;
       #endif
       #ifdef IC_DIR_DOWN //-x, y
-        IMU.readAcceleration(roll, pitch, nah); roll = -roll;
+        imuAccel(roll, pitch, nah); roll = -roll;
       #endif
     #endif //USB_DIR_RIGHT
 
     #ifdef USB_DIR_FRONT
       #ifdef IC_DIR_LEFT //z, -x
-        IMU.readAcceleration(pitch, nah, roll); pitch = -pitch;
+        imuAccel(pitch, nah, roll); pitch = -pitch;
       #endif
       #ifdef IC_DIR_RIGHT //-z, -x
-        IMU.readAcceleration(pitch, nah, roll); roll = -roll; pitch = -pitch;
+        imuAccel(pitch, nah, roll); roll = -roll; pitch = -pitch;
       #endif
       #ifdef IC_DIR_UP //-y, -x
-        IMU.readAcceleration(pitch, roll, nah); roll = -roll; pitch = -pitch;
+        imuAccel(pitch, roll, nah); roll = -roll; pitch = -pitch;
       #endif
       #ifdef IC_DIR_DOWN //y, -x
-        IMU.readAcceleration(pitch, roll, nah); pitch = -pitch;
+        imuAccel(pitch, roll, nah); pitch = -pitch;
       #endif
     #endif //USB_DIR_FRONT
 
     #ifdef USB_DIR_BACK
       #ifdef IC_DIR_LEFT //z, x
-        IMU.readAcceleration(pitch, nah, roll);
+        imuAccel(pitch, nah, roll);
       #endif
       #ifdef IC_DIR_RIGHT //-z, x
-        IMU.readAcceleration(pitch, nah, roll); roll = -roll;
+        imuAccel(pitch, nah, roll); roll = -roll;
       #endif
       #ifdef IC_DIR_UP //y, x
-        IMU.readAcceleration(pitch, roll, nah);
+        imuAccel(pitch, roll, nah);
       #endif
       #ifdef IC_DIR_DOWN //-y, x
-        IMU.readAcceleration(pitch, roll, nah); roll = -roll;
+        imuAccel(pitch, roll, nah); roll = -roll;
       #endif
     #endif //USB_DIR_BACK
       
-    //should activate (>=1) at 30 degrees (reading of >=1/3)
-    roll *= 3;
-    pitch *= 3;
+    //should activate (>=1) at 30 degrees (reading of >=1/3g)
+    roll = ((long)roll*3)/IMU_1G;
+    pitch = ((long)pitch*3)/IMU_1G;
     
     //only update imuLastChange if the value has changed
-    if((int)roll !=imuRoll)  { imuRoll  = (int)roll;  imuLastChange = now; }
-    if((int)pitch!=imuPitch) { imuPitch = (int)pitch; imuLastChange = now; }
+    if(roll !=imuRoll)  { imuRoll  = roll;  imuLastChange = now; }
+    if(pitch!=imuPitch) { imuPitch = pitch; imuLastChange = now; }
     
   } //end readIMU  
   
 #endif //INPUT_IMU
 
-byte inputCur = 0; //Momentary button (or IMU position) currently in use - only one allowed at a time
-byte inputCurHeld = 0; //Button hold thresholds: 0=none, 1=unused, 2=short, 3=long, 4=verylong, 5=superlong, 10=set by inputStop()
+#ifdef INPUT_BUTTONS
+  //Pin reading, resolved at compile time per the configured pin:
+  //disabled (-1) pins compile out, analog-only pins (A6/A7) read a cached conversion, and on AVR, others read their PINx register directly.
+  constexpr byte inputPinKind(int pin){ return pin<=0? 0: (pin==A6||pin==A7)? 2: 1; } //0=disabled, 1=digital, 2=analog-only
+  template<int pin, byte kind=inputPinKind(pin)> struct InputPin { //disabled
+    static void init(){}
+    static bool read(){ return 0; }
+  };
+  template<int pin> struct InputPin<pin,1> { //digital
+    #ifdef __AVR__
+      static volatile uint8_t *in; static uint8_t mask; //the pin's PINx register and bit, cached at init, since the Arduino lookups for these aren't constexpr
+      static void init(){ pinMode(pin,INPUT_PULLUP); in = portInputRegister(digitalPinToPort(pin)); mask = digitalPinToBitMask(pin); }
+      static bool read(){ return !(*in&mask); } //low when pressed
+    #else
+      static void init(){ pinMode(pin,INPUT_PULLUP); }
+      static bool read(){ return !(digitalRead(pin)); } //low when pressed
+    #endif
+  };
+  #ifdef __AVR__
+    template<int pin> volatile uint8_t *InputPin<pin,1>::in = 0;
+    template<int pin> uint8_t InputPin<pin,1>::mask = 0;
+    //Analog-only pins are read by the ADC running continuously in the background: each conversion's interrupt
+    //records whether the reading was low, then starts the next, alternating between channels if both are in use.
+    //A button read is then a bit test, rather than an analogRead taking ~100µs. This takes over the ADC, so nothing else may use analogRead.
+    volatile byte adcLow = 0; //per ADC channel bit: whether its last reading was low (pressed)
+    byte adcChans = 0; //per ADC channel bit: which are in use
+    ISR(ADC_vect){
+      byte ch = ADMUX&0x0F;
+      if(ADC<100) adcLow |= bit(ch); else adcLow &= ~bit(ch);
+      if(adcChans==(bit(6)|bit(7))) ch ^= 1; //alternate between A6 and A7
+      ADMUX = bit(REFS0)|ch;
+      ADCSRA |= bit(ADSC);
+    }
+    template<int pin> struct InputPin<pin,2> { //analog-only
+      static void init(){
+        byte ch = pin-A0;
+        adcChans |= bit(ch);
+        if(ADCSRA&bit(ADIE)) return; //already running
+        ADMUX = bit(REFS0)|ch; //AVcc reference
+        ADCSRA = bit(ADEN)|bit(ADIE)|bit(ADSC)|bit(ADPS2)|bit(ADPS1)|bit(ADPS0); //prescaler 128
+      }
+      static bool read(){ return adcLow&bit(pin-A0); }
+    };
+  #else
+    template<int pin> struct InputPin<pin,2> { //analog-only
+      static void init(){}
+      static bool read(){ return analogRead(pin)<100; }
+    };
+  #endif
+#endif //INPUT_BUTTONS
 
-unsigned long inputLast = 0; //When an input last took place, millis()
-int inputLastTODMins = 0; //When an input last took place, time of day. Used in paginated functions so they all reflect the time of day when the input happened.
+#ifdef INPUT_BUTTONS
+  //Interrupt-captured edge times for CTRL_SEL and CTRL_ALT
+  //Polling only notices a press or release when checkInputs gets round to it, possibly after other slow work (e.g. I2C) that loop pass.
+  //For the timer (start/stop per Sel, laps per Alt), that delay would be measurement error, so we also catch their edges by interrupt, and record when they actually happened.
+  //Each capture also records the pin's level, so it's only used for a debounced change to that level – not, say, for a press that follows noise.
+  volatile unsigned long edgeMicros[2] = {0,0}; //per btnSlot (Sel, Alt): micros() at the last accepted edge
+  volatile byte edgeNew = 0; //per btnSlot bit: set when an edge is accepted, cleared when checkBtn picks it up (or it expires – see edgeExpire)
+  volatile byte edgeLevel = 0; //per btnSlot bit: the pin's level just after the last accepted edge (1=pressed)
 
-bool initInputs(){
-  //TODO are there no "loose" pins left floating after this? per https://electronics.stackexchange.com/q/37696/151805
-  #ifdef INPUT_BUTTONS
-    pinMode(CTRL_SEL, INPUT_PULLUP);
-    if(CTRL_ALT>0){ //preprocessor directives don't seem to work for this when e.g. "A7"
-      pinMode(CTRL_ALT, INPUT_PULLUP);
+  unsigned long edgeLast[2] = {0,0}; //per btnSlot: micros() at the last edge of any kind – only touched by edgeAccept
+
+  void IRAM_ATTR edgeAccept(byte i, unsigned long now, bool level){ //"private"
+    //Only accept the first edge of a bounce: one after the pin has been quiet for DEBOUNCE_DUR. The rest of the bounce keeps it from being quiet.
+    if((unsigned long)(now-edgeLast[i])>=(unsigned long)DEBOUNCE_DUR*1000){ edgeMicros[i] = now; bitWrite(edgeLevel,i,level); edgeNew |= bit(i); }
+    edgeLast[i] = now;
+  }
+  void IRAM_ATTR selEdgeISR(){ edgeAccept(0,micros(),InputPin<CTRL_SEL>::read()); }
+  void IRAM_ATTR altEdgeISR(){ edgeAccept(1,micros(),InputPin<CTRL_ALT>::read()); }
+  #if defined(__AVR__) && defined(PCICR)
+    //If a pin has no external interrupt (e.g. A1 on a Nano), we use a pin change interrupt. Only Sel/Alt (and a rotary encoder's pins) are enabled
+    //in the pin change masks, so we can share one handler for all ports, which works out which of them changed.
+    //A pin's reading in edgePins is only kept up to date while it's on the pin change interrupt, so it's re-sampled whenever it's moved onto it.
+    byte edgePins = 0; //Sel/Alt readings as of the last pin change, per btnSlot bit
+    byte edgePcint = 0; //which of Sel/Alt are on the pin change interrupt, per btnSlot bit – the others' edges are caught by their external interrupts
+    ISR(PCINT0_vect){
+      unsigned long now = micros();
+      byte pins = InputPin<CTRL_SEL>::read()|(InputPin<CTRL_ALT>::read()<<1);
+      byte changed = (pins^edgePins)&edgePcint; edgePins = pins;
+      if(changed&1) edgeAccept(0,now,pins&1);
+      if(changed&2) edgeAccept(1,now,pins&2);
+      #ifdef INPUT_UPDN_ROTARY
+        rotISR(); //no change if it wasn't the encoder
+      #endif
     }
-    #ifdef INPUT_UPDN_BUTTONS
-      pinMode(CTRL_UP, INPUT_PULLUP);
-      pinMode(CTRL_DN, INPUT_PULLUP);
+    #ifdef PCINT1_vect
+    ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+    #endif
+    #ifdef PCINT2_vect
+    ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
     #endif
   #endif
-  #ifdef INPUT_UPDN_ROTARY
-    //rotary needs no init here
+  template<int pin> void edgeAttach(void (*isr)()){ //"private"
+    //Catches pin's edges by interrupt – external interrupt if the pin has one, else pin change (AVR)
+    if(inputPinKind(pin)!=1) return; //disabled or analog-only
+    if(digitalPinToInterrupt(pin)!=NOT_AN_INTERRUPT) attachInterrupt(digitalPinToInterrupt(pin),isr,CHANGE);
+    #if defined(__AVR__) && defined(PCICR)
+      else if(digitalPinToPCICR(pin)){
+        edgePcint |= (pin==CTRL_SEL? 1: 2);
+        *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+        PCIFR |= bit(digitalPinToPCICRbit(pin)); //clear any pending
+        PCICR |= bit(digitalPinToPCICRbit(pin));
+      }
+    #endif
+  }
+#endif
+
+#ifdef INPUT_UPDN_ROTARY
+  //Rotary encoder decoding
+  //Rather than polling the encoder's pins – which misses states whenever something else holds up the loop – its quadrature states are counted
+  //as they happen: in hardware on ESP32, else by interrupt. Each detent is 4 states, and checkRot takes whole detents from the count.
+  //A is CTRL_UP and B is CTRL_DN – if it turns the wrong way, swap them in the config.
+  int rotPend = 0; //detents taken from the count, but not yet sent (positive for up)
+  unsigned long rotEvtLast = 0; //when checkRot last queued an event, millis()
+  #ifdef ESP32
+    //The pulse counter (PCNT) decodes it in hardware: two channels count both edges of each pin, per the level of the other.
+    #include <driver/pcnt.h>
+    #ifndef ROT_PCNT_UNIT
+    #define ROT_PCNT_UNIT PCNT_UNIT_1 //not TIMEBASE_32K's unit 0
+    #endif
+    #ifdef TIMEBASE_32K
+    #include "timebase32k.h" //for TB_PCNT_UNIT
+    static_assert(ROT_PCNT_UNIT!=TB_PCNT_UNIT, "the rotary encoder and TIMEBASE_32K need different PCNT units – see ROT_PCNT_UNIT and TB_PCNT_UNIT");
+    #endif
+    #ifndef ROT_FILTER
+    #define ROT_FILTER 1023 //APB clock cycles (12.5ns) – pulses shorter than this are contact bounce, and ignored. 1023 is the most.
+    #endif
+    int16_t rotBase = 0; //the count as of the last whole detent taken by rotTake
+    void rotInit(){ //"private"
+      pinMode(CTRL_UP,INPUT_PULLUP); pinMode(CTRL_DN,INPUT_PULLUP);
+      pcnt_config_t cfg;
+      cfg.unit = ROT_PCNT_UNIT; cfg.counter_h_lim = 32767; cfg.counter_l_lim = -32768;
+      cfg.channel = PCNT_CHANNEL_0; cfg.pulse_gpio_num = CTRL_UP; cfg.ctrl_gpio_num = CTRL_DN;
+      cfg.pos_mode = PCNT_COUNT_DEC; cfg.neg_mode = PCNT_COUNT_INC; cfg.lctrl_mode = PCNT_MODE_REVERSE; cfg.hctrl_mode = PCNT_MODE_KEEP;
+      pcnt_unit_config(&cfg);
+      cfg.channel = PCNT_CHANNEL_1; cfg.pulse_gpio_num = CTRL_DN; cfg.ctrl_gpio_num = CTRL_UP;
+      cfg.pos_mode = PCNT_COUNT_INC; cfg.neg_mode = PCNT_COUNT_DEC;
+      pcnt_unit_config(&cfg);
+      pcnt_set_filter_value(ROT_PCNT_UNIT,ROT_FILTER); pcnt_filter_enable(ROT_PCNT_UNIT);
+      pcnt_counter_pause(ROT_PCNT_UNIT); pcnt_counter_clear(ROT_PCNT_UNIT); pcnt_counter_resume(ROT_PCNT_UNIT);
+    }
+    int rotTake(){ //"private"
+      //Returns the whole detents turned since last time (positive for up), leaving any part-turned detent in the count
+      int16_t v; pcnt_get_counter_value(ROT_PCNT_UNIT,&v);
+      int d = (v-rotBase)/4;
+      rotBase += d*4;
+      if(rotBase>16000 || rotBase<-16000){ pcnt_counter_clear(ROT_PCNT_UNIT); rotBase = 0; } //well before the counter's limit, where it would reset itself. May drop a part-turned detent.
+      return d;
+    }
+  #else
+    //Each pin change looks up the step from the last state to this one: +/-1 for a move to a neighbouring state, 0 for no change (or an impossible jump, missed or bounced).
+    const int8_t rotSteps[16] PROGMEM = {0,1,-1,0, -1,0,0,1, 1,0,0,-1, 0,-1,1,0}; //[last state*4 + this state], per state = B<<1|A
+    byte rotState = 0; //the last state – only touched by rotISR
+    volatile int rotCount = 0; //states stepped, net (positive for up)
+    void IRAM_ATTR rotISR(){
+      byte st = InputPin<CTRL_UP>::read()|(InputPin<CTRL_DN>::read()<<1);
+      rotCount += (int8_t)pgm_read_byte(&rotSteps[(rotState<<2)|st]);
+      rotState = st;
+    }
+    void rotInit(){ //"private"
+      static_assert(inputPinKind(CTRL_UP)==1 && inputPinKind(CTRL_DN)==1, "INPUT_UPDN_ROTARY needs CTRL_UP and CTRL_DN on digital pins");
+      InputPin<CTRL_UP>::init(); InputPin<CTRL_DN>::init();
+      rotState = InputPin<CTRL_UP>::read()|(InputPin<CTRL_DN>::read()<<1);
+      edgeAttach<CTRL_UP>(rotISR); //external interrupts if the pins have them, else pin change (see the shared handler above)
+      edgeAttach<CTRL_DN>(rotISR);
+    }
+    int rotTake(){ //"private"
+      //Returns the whole detents turned since last time (positive for up), leaving any part-turned detent in the count
+      noInterrupts(); int d = rotCount/4; rotCount -= d*4; interrupts();
+      return d;
+    }
   #endif
-  #ifdef INPUT_IMU
-    //if(!IMU.begin()){ Serial.println(F("Failed to initialize IMU!")); while(1); }
-    IMU.begin();
-    //Serial.println(F("IMU initialized"));
+#endif
+
+unsigned long inputEdgeMicros = 0; //When the input event being passed to ctrlEvt took place, micros() – per interrupt if captured, else when polled
+
+//Input event queue
+//Rather than calling ctrlEvt as soon as an input event is detected – whose consequences may take a while, during which we could miss
+//another edge – input scanning queues each event with its timestamp, and the main loop drains them into ctrlEvt (see inputDrain).
+//There is one producer (input scanning) and one consumer (inputDrain), and each index is only written by one side, so no locking is needed.
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE 8 //must be a power of 2
+#endif
+struct InputEvt { byte ctrl; byte evt; byte evtLast; word steps; unsigned long t; }; //per ctrlEvt args, plus inputEdgeMicros
+InputEvt inputQueue[INPUT_QUEUE_SIZE];
+volatile byte inputQueueHead = 0; //count of events written – only written by queueEvt
+volatile byte inputQueueTail = 0; //count of events read – only written by inputDrain
+word inputDropped = 0; //count of events lost because the queue was full
+
+void queueEvt(byte ctrl, byte evt, byte evtLast, word steps, unsigned long t){
+  byte head = inputQueueHead;
+  if((byte)(head-inputQueueTail)>=INPUT_QUEUE_SIZE){ if(inputDropped<0xFFFF) inputDropped++; return; } //full
+  InputEvt &e = inputQueue[head&(INPUT_QUEUE_SIZE-1)];
+  e.ctrl = ctrl; e.evt = evt; e.evtLast = evtLast; e.steps = steps; e.t = t;
+  inputQueueHead = head+1; //publish
+}
+void inputDrain(){
+  //Called by the main loop: passes queued input events to ctrlEvt, in order
+  while(inputQueueTail!=inputQueueHead){
+    InputEvt &e = inputQueue[inputQueueTail&(INPUT_QUEUE_SIZE-1)];
+    inputEdgeMicros = e.t;
+    #ifdef ENABLE_PROFILER
+      if(e.evt==1) profRecord(PROF_LATENCY,micros()-e.t); //from the press itself, as captured
+    #endif
+    ctrlEvt(e.ctrl,e.evt,e.evtLast,e.steps);
+    inputQueueTail++;
+  }
+}
+word getInputDropped(){
+  return inputDropped;
+}
+
+unsigned long takeEdgeMicros(byte btn, bool level){ //"private"
+  //Returns when btn's current press (level 1) or release (0) took place: for Sel/Alt, per the interrupt if it caught an edge to that level, else now
+  #ifdef INPUT_BUTTONS
+    byte i = btnSlot(btn);
+    if(i<2 && (edgeNew&bit(i))){
+      noInterrupts(); unsigned long t = edgeMicros[i]; bool match = (bitRead(edgeLevel,i)==level); edgeNew &= ~bit(i); interrupts();
+      if(match) return t;
+    }
+  #endif
+  return micros();
+}
+void edgeExpire(byte i){ //"private"
+  //Called when polling sees no change on input i: an edge it hasn't matched within the debounce window was noise, so it's discarded
+  #ifdef INPUT_BUTTONS
+    if(i>=2 || !(edgeNew&bit(i))) return;
+    unsigned long now = micros();
+    noInterrupts();
+    if((unsigned long)(now-edgeMicros[i])>=(unsigned long)DEBOUNCE_DUR*1000) edgeNew &= ~bit(i);
+    interrupts();
   #endif
-  //Check to see if CTRL_SEL is held at init - facilitates version number display and EEPROM hard init
-  delay(100); //prevents the below from firing in the event there's a capacitor stabilizing the input, which can read low falsely
-  if(readBtn(CTRL_SEL)){ inputCur = CTRL_SEL; return true; }
-  else return false;
 }
 
-bool readBtn(byte btn){
+byte inputCur = 0; //Momentary button (or IMU position) currently in use - only one allowed at a time (others only send a press – see checkBtn)
+byte inputCurHeld = 0; //Button hold thresholds: 0=none, 1=unused, 2=short, 3=long, 4=verylong, 5=superlong, 10=set by inputStop()
+
+unsigned long inputLast = 0; //When an input last took place, millis()
+int inputLastTODMins = 0; //When an input last took place, time of day. Used in paginated functions so they all reflect the time of day when the input happened.
+
+//Debounce
+//Each input is debounced on its own: a change in its reading is passed through immediately, if the reading had settled before it –
+//held steady for DEBOUNCE_DUR. The bounce that follows is ignored, but the input is ready again as soon as it settles,
+//so e.g. a stop and restart on Sel can follow each other as fast as a finger can. If a bounce ends away from the debounced state, that's taken once it settles.
+byte btnStable = 0; //debounced state of each input, per btnSlot (bit: 1=pressed)
+byte btnChord = 0; //inputs pressed while another was in use, per btnSlot – these are ignored until released
+byte btnRaw = 0; //last reading of each input, per btnSlot
+unsigned long btnRawLast[4] = {0,0,0,0}; //when each input's reading last changed, millis()
+byte btnSlot(byte btn){ //"private"
+  if(btn==CTRL_SEL) return 0;
+  if(btn==CTRL_ALT) return 1;
+  if(btn==CTRL_UP) return 2;
+  return 3; //CTRL_DN
+}
+bool debounceBtn(byte btn, bool raw, unsigned long now){
+  byte i = btnSlot(btn);
+  bool settled = (unsigned long)(now-btnRawLast[i])>=DEBOUNCE_DUR; //as of the reading before this one
+  if(raw!=bitRead(btnRaw,i)){ bitWrite(btnRaw,i,raw); btnRawLast[i] = now; }
+  if(raw!=bitRead(btnStable,i) && settled) bitWrite(btnStable,i,raw);
+  else edgeExpire(i);
+  return bitRead(btnStable,i);
+}
+
+
+//Whether a control is equipped, at compile time, so checkInputs can skip the rest
+#ifdef INPUT_IMU
+  #define BTN_EQUIPPED(btn) 1
+#else
+  #define BTN_EQUIPPED(btn) (inputPinKind(btn)>0)
+#endif
+
+template<int btn> bool readBtn(){ //"private"
   //Reads momentary button and/or IMU position, as equipped
   #ifdef INPUT_BUTTONS
-    if(btn>0){ //skip disabled alt
-      if(btn==A6 || btn==A7) return analogRead(btn)<100; //analog-only pins
-      else return !(digitalRead(btn)); //false (low) when pressed
-    }
+    if(inputPinKind(btn)) return InputPin<btn>::read(); //skip disabled alt
   #endif
   #ifdef INPUT_IMU
     //report using current roll/pitch values
@@ -229,40 +534,98 @@ bool readBtn(byte btn){
   return 0;
 }
 
+#ifndef INPUT_SETTLE_DUR
+#define INPUT_SETTLE_DUR 100 //ms – after init, inputs aren't checked for this long, in case there's a capacitor stabilizing the input, which can read low falsely
+#endif
+bool inputSettling = 1; //until INPUT_SETTLE_DUR after init
+unsigned long inputInitMillis = 0;
+
+void initInputs(){
+  //TODO are there no "loose" pins left floating after this? per https://electronics.stackexchange.com/q/37696/151805
+  #ifdef INPUT_BUTTONS
+    InputPin<CTRL_SEL>::init();
+    InputPin<CTRL_ALT>::init(); //nothing, if disabled
+    #ifdef INPUT_UPDN_BUTTONS
+      InputPin<CTRL_UP>::init();
+      InputPin<CTRL_DN>::init();
+    #endif
+    //Catch Sel/Alt edges by interrupt (see edgeAccept)
+    #if defined(__AVR__) && defined(PCICR)
+      edgePins = InputPin<CTRL_SEL>::read()|(InputPin<CTRL_ALT>::read()<<1);
+    #endif
+    edgeAttach<CTRL_SEL>(selEdgeISR);
+    edgeAttach<CTRL_ALT>(altEdgeISR);
+  #endif
+  #ifdef INPUT_UPDN_ROTARY
+    rotInit();
+  #endif
+  #ifdef INPUT_IMU
+    initIMU();
+  #endif
+  //Rather than waiting here for the inputs to settle, checkInputs holds off until they have (see inputSettled), so setup can carry on
+  inputInitMillis = millis();
+}
+bool inputSettled(unsigned long now){ //"private"
+  //Returns whether the inputs have settled since init. The first time they have, checks to see if CTRL_SEL is held
+  //(facilitates version number display and EEPROM hard init) – if so, it's treated as already in use, so it won't register as a press.
+  if(!inputSettling) return 1;
+  if((unsigned long)(now-inputInitMillis)<INPUT_SETTLE_DUR) return 0;
+  inputSettling = 0;
+  #ifdef INPUT_BUTTONS
+    edgeNew = 0; //any edges so far were settling
+  #endif
+  if(readBtn<CTRL_SEL>()){ inputCur = CTRL_SEL; bitWrite(btnStable,0,1); }
+  return 1;
+}
+
 unsigned long holdLast;
-void checkBtn(byte btn, unsigned long now){
-  //Polls for changes in momentary buttons (or IMU positioning), LOW = pressed.
-  //When a button event has occurred, will call ctrlEvt in main code.
+void checkBtn(byte btn, bool raw, unsigned long now){
+  //Polls for changes in momentary buttons (or IMU positioning), per raw reading from readBtn (1 = pressed).
+  //When a button event has occurred, will queue it for ctrlEvt in main code (see inputDrain).
   //Only called by checkInputs() and only for inputs configured as button and/or IMU.
-  bool bnow = readBtn(btn);
+  bool bnow = debounceBtn(btn,raw,now);
+  unsigned long edge; //when the event took place, micros()
+  //If another button is in use, a press of this one (e.g. Alt while Sel is held, for a lap) only sends a press event,
+  //and this one is then ignored until released, so it doesn't take over once the other is released.
+  byte i = btnSlot(btn);
+  if(bitRead(btnChord,i)){
+    if(!bnow){ bitWrite(btnChord,i,0); takeEdgeMicros(btn,0); } //released – discard its edge
+    return;
+  }
+  if(inputCur!=0 && inputCur!=btn){
+    if(bnow){ bitWrite(btnChord,i,1); queueEvt(btn,1,0,1,takeEdgeMicros(btn,1)); }
+    return;
+  }
   //If the button has just been pressed, and no other buttons are in use...
   if(inputCur==0 && bnow) {
     // Serial.print(F("Btn "));
     // Serial.print(btn,DEC);
     // Serial.println(F(" pressed"));
     inputCur = btn; inputCurHeld = 0; inputLast = now; inputLastTODMins = rtcGetTOD();
+    edge = takeEdgeMicros(btn,1);
     //Serial.println(); Serial.println(F("ich now 0 per press"));
-    ctrlEvt(btn,1,inputCurHeld); //hey, the button has been pressed
+    queueEvt(btn,1,inputCurHeld,1,edge); //hey, the button has been pressed
     //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" after press > ctrlEvt"));
   }
   //If the button is being held...
   if(inputCur==btn && bnow) {
+    edge = micros(); //hold events happen when we notice them
     //If the button has passed a hold duration threshold... (ctrlEvt will only act on these for Sel/Alt)
     if((unsigned long)(now-inputLast)>=CTRL_HOLD_SUPERLONG_DUR && inputCurHeld < 5){
-      ctrlEvt(btn,5,inputCurHeld); if(inputCurHeld<10) inputCurHeld = 5;
+      queueEvt(btn,5,inputCurHeld,1,edge); if(inputCurHeld<10) inputCurHeld = 5;
       //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" after 5 hold > ctrlEvt"));
     }
     else if((unsigned long)(now-inputLast)>=CTRL_HOLD_VERYLONG_DUR && inputCurHeld < 4){
-      ctrlEvt(btn,4,inputCurHeld); if(inputCurHeld<10) inputCurHeld = 4;
+      queueEvt(btn,4,inputCurHeld,1,edge); if(inputCurHeld<10) inputCurHeld = 4;
       //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" after 4 hold > ctrlEvt"));
     }
     else if((unsigned long)(now-inputLast)>=CTRL_HOLD_LONG_DUR && inputCurHeld < 3){
-      ctrlEvt(btn,3,inputCurHeld); if(inputCurHeld<10) inputCurHeld = 3;
+      queueEvt(btn,3,inputCurHeld,1,edge); if(inputCurHeld<10) inputCurHeld = 3;
       //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" after 3 hold > ctrlEvt"));
     }
     else if((unsigned long)(now-inputLast)>=CTRL_HOLD_SHORT_DUR && inputCurHeld < 2) {
       //Serial.print(F("ich was ")); Serial.println(inputCurHeld,DEC);
-      ctrlEvt(btn,2,inputCurHeld); if(inputCurHeld<10) inputCurHeld = 2;
+      queueEvt(btn,2,inputCurHeld,1,edge); if(inputCurHeld<10) inputCurHeld = 2;
       //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" after 2 hold > ctrlEvt"));
       holdLast = now; //starts the repeated presses code going
     }
@@ -271,7 +634,7 @@ void checkBtn(byte btn, unsigned long now){
       if((btn==CTRL_UP || btn==CTRL_DN) && inputCurHeld >= 2){
         if((unsigned long)(now-holdLast)>=(inputCurHeld>=3?HOLDSET_FAST_RATE:HOLDSET_SLOW_RATE)){ //could make it nonlinear?
           holdLast = now;
-          ctrlEvt(btn,1,inputCurHeld);
+          queueEvt(btn,1,inputCurHeld,1,edge);
         }
       }
     #endif
@@ -279,9 +642,10 @@ void checkBtn(byte btn, unsigned long now){
   //If the button has just been released...
   if(inputCur==btn && !bnow) {
     inputLast = now; //stopwatch should consider a release an event
+    edge = takeEdgeMicros(btn,0);
     inputCur = 0;
     //Only act if the button hasn't been stopped
-    if(inputCurHeld<10) ctrlEvt(btn,0,inputCurHeld); //hey, the button was released after inputCurHeld
+    if(inputCurHeld<10) queueEvt(btn,0,inputCurHeld,1,edge); //hey, the button was released after inputCurHeld
     //Serial.print(F("ich now ")); Serial.print(inputCurHeld,DEC); Serial.println(F(" then 0 after release > ctrlEvt"));
     inputCurHeld = 0;
   }
@@ -292,51 +656,111 @@ void inputStop(){
   //Serial.println(F("ich now 10 per inputStop"));
 }
 
+bool inputBusy(){
+  //Whether an input is in use, or has events waiting for ctrlEvt
+  #ifdef INPUT_UPDN_ROTARY
+    if(rotPend) return 1; //detents being gathered (see checkRot)
+  #endif
+  return inputCur || inputQueueTail!=inputQueueHead;
+}
+#ifdef IDLE_SLEEP
+void inputSleep(){
+  //Called by the main code when idle: sleeps the MCU until Sel is pressed. The wake edge is captured like any other (see edgeAccept),
+  //so the press that wakes us is also handled as a press, timestamped as it happened. Returns at once if an edge is already waiting.
+  static_assert(inputPinKind(CTRL_SEL)==1, "IDLE_SLEEP needs CTRL_SEL on a digital pin, to wake on");
+  if(edgeNew) return;
+  #if defined(__AVR__) && defined(PCICR)
+    //Power-down. External interrupts can only wake from it on a low level, but pin change interrupts wake on any change,
+    //so we enable Sel's for the duration, and the pin change handler captures the edge.
+    volatile uint8_t *pcmsk = digitalPinToPCMSK(CTRL_SEL);
+    byte pcmskWas = *pcmsk; byte pcicrWas = PCICR; byte pcintWas = edgePcint;
+    noInterrupts(); //so the handler can't run between sampling Sel and enabling its pin change
+    if(!(edgePcint&1)) edgePins = (edgePins&~1)|InputPin<CTRL_SEL>::read(); //Sel is moving onto the pin change interrupt, so its reading is stale
+    edgePcint |= 1;
+    *pcmsk |= bit(digitalPinToPCMSKbit(CTRL_SEL));
+    PCICR |= bit(digitalPinToPCICRbit(CTRL_SEL));
+    interrupts();
+    byte adcWas = ADCSRA; ADCSRA = 0; //ADC off – it can't convert in power-down, but would still draw current
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    noInterrupts();
+    if(!edgeNew){ //else Sel changed since we checked
+      sleep_enable();
+      #if defined(BODS) && defined(BODSE)
+        sleep_bod_disable(); //brown-out detector off while asleep
+      #endif
+      interrupts(); sleep_cpu(); //the instruction after interrupts() runs before any interrupt, so an edge in between still wakes us
+      sleep_disable();
+    }
+    interrupts();
+    ADCSRA = adcWas; if(adcWas&bit(ADIE)) ADCSRA |= bit(ADSC); //restart the free-running conversions, if any (see InputPin)
+    noInterrupts();
+    *pcmsk = pcmskWas; PCICR = pcicrWas; edgePcint = pcintWas; //Sel back on its external interrupt, if it has one, and out of the handler's reckoning
+    interrupts();
+  #elif defined(ESP32)
+    //Light sleep, waking when Sel is low. The edge interrupt is disabled meanwhile, so the level doesn't also fire it;
+    //the edge can't be captured during sleep anyway, so we capture it on waking – less the wake-up time (well under a ms).
+    gpio_num_t pin = (gpio_num_t)CTRL_SEL;
+    gpio_intr_disable(pin);
+    gpio_wakeup_enable(pin,GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    esp_light_sleep_start();
+    gpio_wakeup_disable(pin);
+    gpio_set_intr_type(pin,GPIO_INTR_ANYEDGE); //as attached by edgeAttach
+    gpio_intr_enable(pin);
+    if(esp_sleep_get_wakeup_cause()==ESP_SLEEP_WAKEUP_GPIO){ noInterrupts(); edgeAccept(0,micros(),1); interrupts(); }
+  #endif
+}
+#endif
+
 #ifdef INPUT_UPDN_ROTARY
-bool rotVel = 0; //high velocity setting (x10 rather than x1)
-unsigned long rotLastStep = 0; //timestamp of last completed step (detent)
-int rotLastVal = 0;
+#ifndef ROT_BATCH_MS
+#define ROT_BATCH_MS 50 //ms – detents turned within this long of the last event are gathered into the next one
+#endif
+#ifndef ROT_ACCEL_MS
+#define ROT_ACCEL_MS 100 //ms – turning faster than a detent per this long scales each detent up, in proportion to the speed...
+#endif
+#ifndef ROT_ACCEL_MAX
+#define ROT_ACCEL_MAX 10 //...up to this many steps per detent
+#endif
 void checkRot(unsigned long now){
-  //Changes in rotary encoder. When rotation(s) occur, will call ctrlEvt to simulate btn presses. During setting, ctrlEvt will take rotVel into account.
-  int rotCurVal = rot.read();
-  if(rotCurVal!=rotLastVal){ //we've sensed a state change
-    rotLastVal = rotCurVal;
-    if(rotCurVal>=4 || rotCurVal<=-4){ //we've completed a step of 4 states (this library doesn't seem to drop states much, so this is reasonably reliable)
-      inputLast = now; inputLastTODMins = rtcGetTOD();
-      if((unsigned long)(now-rotLastStep)<=ROT_VEL_START) rotVel = 1; //kick into high velocity setting (x10)
-      else if((unsigned long)(now-rotLastStep)>=ROT_VEL_STOP) rotVel = 0; //fall into low velocity setting (x1)
-      rotLastStep = now;
-      while(rotCurVal>=4) { rotCurVal-=4; ctrlEvt(CTRL_UP,1,inputCurHeld,rotVel); }
-      while(rotCurVal<=-4) { rotCurVal+=4; ctrlEvt(CTRL_DN,1,inputCurHeld,rotVel); }
-      rot.write(rotCurVal);
-    }
-  }
+  //Changes in rotary encoder. Rather than an event per detent, queues one Up/Dn press event for ctrlEvt with the steps turned since the last,
+  //at most one per ROT_BATCH_MS – so a fast spin costs one event (and one redraw) per batch. The first detent after a pause goes at once.
+  //The steps are the detents times a multiplier that rises continuously with the speed they were turned at: 1 at up to a detent per ROT_ACCEL_MS.
+  rotPend += rotTake();
+  if(!rotPend) return;
+  unsigned long el = now-rotEvtLast;
+  if(el<ROT_BATCH_MS) return; //gather more
+  word d = (rotPend<0? -rotPend: rotPend);
+  unsigned long m = (unsigned long)ROT_ACCEL_MS*d/el;
+  if(m<1) m = 1; else if(m>ROT_ACCEL_MAX) m = ROT_ACCEL_MAX;
+  unsigned long steps = d*m;
+  inputLast = now; inputLastTODMins = rtcGetTOD();
+  queueEvt(rotPend>0? CTRL_UP: CTRL_DN,1,inputCurHeld,(steps>0xFFFF? 0xFFFF: steps),micros());
+  rotPend = 0; rotEvtLast = now;
 } //end checkRot()
 #endif
 
 void checkInputs(){
   unsigned long now = millis(); //this will be the recorded time of any input change
-  //Debounce
-  if((unsigned long)(now-inputLast)<DEBOUNCE_DUR) return;
+  if(!inputSettled(now)) return;
+  //Debounce is per input (see debounceBtn), so there is no global lockout here
   
   //TODO potential issue: if user only means to rotate or push encoder but does both?
   #ifdef INPUT_IMU
-    readIMU(); //captures IMU state for checkBtn/readBtn to look at
+    readIMU(now); //captures IMU state for checkBtn/readBtn to look at, if there's a new sample
   #endif
-  //checkBtn calls readBtn which will read button and/or IMU as equipped
-  //We just need to only call checkBtn if one or the other is equipped
+  //readBtn will read button and/or IMU as equipped
+  //We just need to only call checkBtn if one or the other is equipped – BTN_EQUIPPED is constant, so the rest compile out
   #if defined(INPUT_BUTTONS) || defined(INPUT_IMU)
-    checkBtn(CTRL_SEL,now);
-    if(CTRL_ALT>0){ //preprocessor directives don't seem to work for this when e.g. "A7"
-      checkBtn(CTRL_ALT,now);
-    }
+    checkBtn(CTRL_SEL,readBtn<CTRL_SEL>(),now);
+    if(BTN_EQUIPPED(CTRL_ALT)) checkBtn(CTRL_ALT,readBtn<CTRL_ALT>(),now);
     #if defined(INPUT_UPDN_BUTTONS) || defined(INPUT_IMU)
-      checkBtn(CTRL_UP,now);
-      checkBtn(CTRL_DN,now);
+      if(BTN_EQUIPPED(CTRL_UP)) checkBtn(CTRL_UP,readBtn<CTRL_UP>(),now);
+      if(BTN_EQUIPPED(CTRL_DN)) checkBtn(CTRL_DN,readBtn<CTRL_DN>(),now);
     #endif
   #endif
   #ifdef INPUT_UPDN_ROTARY
-    checkRot();
+    checkRot(now);
   #endif
 }
 
@@ -351,6 +775,10 @@ void setInputLast(unsigned long increment){
 unsigned long getInputLast(){
   return inputLast;
 }
+unsigned long getInputEdgeMicros(){
+  //Used by ctrlEvt to timestamp events as precisely as possible, e.g. for timer start/stop
+  return inputEdgeMicros;
+}
 int getInputLastTODMins(){
   //Used to ensure paged displays (e.g. calendar) use the same TOD for all pages
   return inputLastTODMins;
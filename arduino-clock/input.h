@@ -20,16 +20,33 @@
 #ifdef INPUT_IMU
 void readIMU(unsigned long now);
 #endif
-bool initInputs();
-bool readBtn(byte btn);
-void checkBtn(byte btn, unsigned long now);
+void initInputs();
+bool inputSettled(unsigned long now);
+byte btnSlot(byte btn);
+bool debounceBtn(byte btn, bool raw, unsigned long now);
+unsigned long takeEdgeMicros(byte btn, bool level);
+void edgeExpire(byte i);
+void queueEvt(byte ctrl, byte evt, byte evtLast, word steps, unsigned long t);
+void inputDrain();
+word getInputDropped();
+void checkBtn(byte btn, bool raw, unsigned long now);
 void inputStop();
+bool inputBusy();
+#ifdef IDLE_SLEEP
+void inputSleep();
+#endif
 #ifdef INPUT_UPDN_ROTARY
+void rotInit();
+int rotTake();
+#ifndef ESP32
+void rotISR();
+#endif
 void checkRot(unsigned long now);
 #endif
 void checkInputs();
 void setInputLast(unsigned long increment=0);
 unsigned long getInputLast();
+unsigned long getInputEdgeMicros();
 int getInputLastTODMins();
 
 #endif //INPUT_H
\ No newline at end of file
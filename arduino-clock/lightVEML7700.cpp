@@ -0,0 +1,86 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#ifdef LIGHTSENSOR_VEML7700 //see arduino-clock.ino Includes section
+
+#include "lightVEML7700.h"
+#include <Wire.h> //Arduino - GNU LPGL - for I2C access to VEML7700
+#include "i2cBus.h" //to take turns on the bus
+
+//The VEML7700 is read by register directly, rather than via a library, as we only need one reading, and to take our turn on the bus for it.
+//Its interrupt only flags thresholds in a register – there's no pin – so rather than polling it, we read it once per measurement, on its own
+//refresh cycle (integration time plus power saving wait), which leaves it asleep in between. Each reading is smoothed, then quantised into
+//display brightness steps, with hysteresis, so the level (and so the display brightness) only changes when the room really has.
+
+//these can be overridden in your config .h
+#ifndef LUX_FULL
+#define LUX_FULL 400 //lux at/above which display should be at its brightest
+#endif
+#ifndef LUX_DIM
+#define LUX_DIM 30 //lux at/below which display should be at its dimmest
+#endif
+#ifndef LIGHT_FILTER_SHIFT
+#define LIGHT_FILTER_SHIFT 2 //smoothing: each reading moves the average 1/2^n of the way – 2 settles over about 4 readings, or 5 seconds
+#endif
+#ifndef LIGHT_HYST
+#define LIGHT_HYST 4 //sixteenths of a step the average must go past the midpoint to the next step, before the level changes (0-7)
+#endif
+
+#define VEML_ADDR 0x10
+#define VEML_REG_CONF 0x00 //ALS_CONF: gain, integration time, shutdown
+#define VEML_REG_PSM 0x03 //power saving mode
+#define VEML_REG_ALS 0x04 //ALS output
+#define VEML_CONF 0x1000 //gain 1/8, integration time 100ms, powered on – up to 30199 lux, at 0.4608 lux per count
+#define VEML_LUX_E4 4608 //lux per count, x10000, at VEML_CONF
+#define VEML_PSM 0x03 //power saving mode 2, enabled – sleeps 1000ms after each 100ms measurement
+#define LIGHT_SAMPLE_MS 1100 //so we read each measurement once, per VEML_CONF and VEML_PSM
+
+#define LIGHT_STEPS 15 //brightness steps, per the 0-15 of the display hardware
+
+unsigned long lightSum = 0; //smoothed lux, x 2^LIGHT_FILTER_SHIFT. 0 until the first reading.
+byte lightStep = 0; //the current quantised level, 0-LIGHT_STEPS
+
+void lightWrite(byte reg, word val){ //"private"
+  Wire.beginTransmission(VEML_ADDR);
+  Wire.write(reg); Wire.write((uint8_t)(val&0xFF)); Wire.write((uint8_t)(val>>8)); //LSB first
+  Wire.endTransmission();
+}
+
+void lightInit(){
+  Wire.begin();
+  lightWrite(VEML_REG_CONF,VEML_CONF);
+  lightWrite(VEML_REG_PSM,VEML_PSM);
+}
+
+unsigned long lightSample(){
+  //Called by the light task. Reads the latest measurement, and updates the level. Returns ms until the next is due.
+  if(!i2cTake(I2C_LIGHT)) return 0; //not our turn on the bus – try again next pass (see i2cBus.cpp)
+  Wire.beginTransmission(VEML_ADDR);
+  Wire.write((uint8_t)VEML_REG_ALS);
+  if(Wire.endTransmission(false)!=0) return LIGHT_SAMPLE_MS; //not there – keep the level we have
+  if(Wire.requestFrom((uint8_t)VEML_ADDR,(uint8_t)2)!=2) return LIGHT_SAMPLE_MS;
+  word raw = Wire.read(); raw |= (word)Wire.read()<<8;
+  unsigned long lux = (unsigned long)raw*VEML_LUX_E4/10000;
+  
+  //Smooth: an exponential moving average, kept as a sum so there's no rounding drift
+  if(!lightSum) lightSum = lux<<LIGHT_FILTER_SHIFT; //start at the first reading
+  else lightSum = lightSum - (lightSum>>LIGHT_FILTER_SHIFT) + lux;
+  lux = lightSum>>LIGHT_FILTER_SHIFT;
+  
+  //Quantise: find the position within LUX_DIM-LUX_FULL, in sixteenths of a step, and only move to another step
+  //if the position is more than LIGHT_HYST past the midpoint between it and the current step
+  long pos;
+  if(lux<=LUX_DIM) pos = 0;
+  else if(lux>=LUX_FULL) pos = LIGHT_STEPS*16;
+  else pos = (long)(lux-LUX_DIM)*LIGHT_STEPS*16/(LUX_FULL-LUX_DIM);
+  long off = pos-(long)lightStep*16;
+  if(off>8+LIGHT_HYST || off<-8-LIGHT_HYST) lightStep = (pos+8)/16;
+  return LIGHT_SAMPLE_MS;
+}
+
+word lightGetLevel(){
+  //The ambient light level for cycleDisplay: 0-255, per LUX_DIM-LUX_FULL, in LIGHT_STEPS steps
+  return (word)lightStep*255/LIGHT_STEPS;
+}
+
+#endif //LIGHTSENSOR_VEML7700
@@ -0,0 +1,10 @@
+#ifndef LIGHT_VEML7700_H
+#define LIGHT_VEML7700_H
+
+//Mutually exclusive with other light sensor options
+
+void lightInit();
+unsigned long lightSample();
+word lightGetLevel();
+
+#endif
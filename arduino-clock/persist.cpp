@@ -0,0 +1,93 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#ifdef PERSIST_STATE //see arduino-clock.ino Includes section
+
+#include "persist.h"
+#include <EEPROM.h> //Arduino - GNU LPGL
+
+#define PERSIST_MAGIC 0x5A
+
+//Records are written to a ring of slots in EEPROM, each: magic, sequence number (2 bytes), record, checksum.
+//On load, the valid slot with the latest sequence number wins. A slot's magic is cleared before the rest is written,
+//and only set once it's complete – so if power fails partway through, that slot is ignored, and the previous one is used
+//(which is in a different slot, so it's intact). The checksum covers the rest.
+//Saves are written a byte per persistCycle, and only once the EEPROM is ready for it, so nothing waits on the EEPROM.
+word persistLen = 0; //record length, per persistInit
+word persistSeq = 0; //sequence number of the latest slot written (or loaded)
+byte persistSlot = PERSIST_SLOTS-1; //the latest slot written (or loaded)
+const byte *persistRec = 0; //the record being saved – must be left alone until persistBusy() is false
+int persistPos = -1; //the next step of writing the slot: 0 clears the magic, then each byte in turn, then the magic; -1 when idle
+byte persistSum = 0; //checksum so far of the slot being written
+
+int persistSlotAddr(byte slot){ //"private"
+  return PERSIST_ADDR+slot*(persistLen+4);
+}
+byte persistSlotByte(int pos){ //"private"
+  //The byte at pos within the slot being written
+  if(pos==0) return PERSIST_MAGIC;
+  if(pos==1) return persistSeq&0xFF;
+  if(pos==2) return persistSeq>>8;
+  if(pos<persistLen+3) return persistRec[pos-3];
+  return persistSum;
+}
+byte persistSumStep(byte sum, byte b){ //"private"
+  return ((sum<<1)|(sum>>7))^b; //rotate and xor
+}
+
+void persistInit(word len){
+  persistLen = len;
+  #ifndef __AVR__
+    EEPROM.begin(PERSIST_ADDR+PERSIST_SLOTS*(len+4)); //emulated in flash
+  #endif
+}
+bool persistLoad(byte *rec){
+  //Finds the latest valid slot and copies its record to rec. Returns false if there isn't one.
+  bool found = 0;
+  for(byte slot=0; slot<PERSIST_SLOTS; slot++){
+    int addr = persistSlotAddr(slot);
+    if(EEPROM.read(addr)!=PERSIST_MAGIC) continue;
+    byte sum = 0;
+    for(int pos=0; pos<persistLen+3; pos++) sum = persistSumStep(sum,EEPROM.read(addr+pos));
+    if(sum!=EEPROM.read(addr+persistLen+3)) continue;
+    word seq = EEPROM.read(addr+1)|(EEPROM.read(addr+2)<<8);
+    if(found && (int16_t)(seq-persistSeq)<=0) continue; //not later (allowing for wraparound)
+    found = 1; persistSeq = seq; persistSlot = slot;
+  }
+  if(!found) return 0;
+  int addr = persistSlotAddr(persistSlot)+3;
+  for(word i=0; i<persistLen; i++) rec[i] = EEPROM.read(addr+i);
+  return 1;
+}
+void persistSave(const byte *rec){
+  //Starts saving rec to the next slot, per persistCycle. Call only when !persistBusy().
+  persistRec = rec;
+  persistSeq++; persistSlot = (persistSlot+1)%PERSIST_SLOTS;
+  persistPos = 0; persistSum = 0;
+}
+bool persistBusy(){
+  return persistPos>=0;
+}
+void persistCycle(){
+  //Called every loop: writes the next byte of the slot being saved, if the EEPROM is ready for it
+  if(persistPos<0) return;
+  #ifdef __AVR__
+    if(!eeprom_is_ready()) return; //the last byte is still being written (~3.3ms each)
+  #endif
+  int pos = (persistPos<=persistLen+3? persistPos: 0); //the last step sets the magic
+  byte b = (persistPos==0? 0: persistSlotByte(pos));
+  if(persistPos<persistLen+3) persistSum = persistSumStep(persistSum,persistSlotByte(persistPos));
+  #ifdef __AVR__
+    EEPROM.update(persistSlotAddr(persistSlot)+pos,b); //only writes if different
+  #else
+    EEPROM.write(persistSlotAddr(persistSlot)+pos,b); //to the RAM copy, until commit
+  #endif
+  if(++persistPos>persistLen+4){
+    persistPos = -1;
+    #ifndef __AVR__
+      EEPROM.commit(); //once per save
+    #endif
+  }
+}
+
+#endif //PERSIST_STATE
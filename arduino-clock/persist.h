@@ -0,0 +1,25 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+//Optional: if PERSIST_STATE is defined in config, timer state is checkpointed to EEPROM (see arduino-clock.ino)
+
+#ifndef PERSIST_ADDR
+#define PERSIST_ADDR 0 //EEPROM address of the first slot
+#endif
+#ifndef PERSIST_SLOTS
+#define PERSIST_SLOTS 8 //how many slots in the ring – each write goes to the next, spreading the wear
+#endif
+#ifdef E2END
+#define PERSIST_EEPROM_SIZE (E2END+1) //AVR: the chip's EEPROM
+#else
+#define PERSIST_EEPROM_SIZE 4096 //ESP32: the most EEPROM.begin can emulate (one flash sector)
+#endif
+//The ring takes PERSIST_ADDR+PERSIST_SLOTS*(len+4) bytes, which must fit PERSIST_EEPROM_SIZE – the caller checks, as it knows len
+
+void persistInit(word len);
+bool persistLoad(byte *rec);
+void persistSave(const byte *rec);
+bool persistBusy();
+void persistCycle();
+
+#endif
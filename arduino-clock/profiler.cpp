@@ -0,0 +1,65 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#ifdef ENABLE_PROFILER //see arduino-clock.ino Includes section
+
+#include "profiler.h"
+#include "telemetry.h"
+
+#if !TELEMETRY_LEVEL
+#error "ENABLE_PROFILER needs TELEMETRY_LEVEL, to dump its results"
+#endif
+
+#define PROF_BUCKETS 16
+#define PROF_ITEMS (4+PROF_BUCKETS) //records per stage in a dump: count, min, max, mean, then each histogram bucket
+
+//Per stage, we keep the min, max and mean time (or for PROF_BUS, bytes) (µs, per micros() – so 4µs resolution on 16MHz AVR), and a histogram with a bucket
+//per power of 2: bucket b counts times under 2^b µs (and at least 2^(b-1)), with the last taking everything longer. The buckets are
+//only a byte each – when one fills up, they're all halved, which keeps the shape of the distribution.
+struct ProfStage {
+  unsigned long count; //samples since the last dump
+  unsigned long sum; //for the mean – halved along with count if it would overflow
+  unsigned long min;
+  unsigned long max;
+  byte hist[PROF_BUCKETS];
+};
+ProfStage profStages[PROF_STAGES];
+int profDumpPos = -1; //during a dump, the next record to send, as stage*PROF_ITEMS+item; -1 when not dumping
+
+void profRecord(byte stage, unsigned long us){
+  //Adds a sample (µs) to stage's stats. Cheap enough to call around every task.
+  ProfStage &s = profStages[stage];
+  if(!s.count || us<s.min) s.min = us;
+  if(us>s.max) s.max = us;
+  if(s.sum>0xFFFFFFFFUL-us){ s.sum >>= 1; s.count >>= 1; }
+  s.sum += us; s.count++;
+  byte b = 0; while(us && b<PROF_BUCKETS-1){ us >>= 1; b++; } //number of bits in us
+  if(s.hist[b]==255) for(byte k=0; k<PROF_BUCKETS; k++) s.hist[k] >>= 1;
+  s.hist[b]++;
+}
+void profDump(){
+  //Starts sending the stats over telemetry (see profCycle), then resets them, so each dump covers the time since the last
+  if(profDumpPos<0) profDumpPos = 0;
+}
+bool profCycle(){
+  //Called by the main loop: sends as much of the dump as the telemetry queue has room for. Returns whether a dump is in progress.
+  while(profDumpPos>=0 && telemetryRoom()>1){ //leave room for other records
+    byte stage = profDumpPos/PROF_ITEMS; byte item = profDumpPos%PROF_ITEMS;
+    ProfStage &s = profStages[stage];
+    if(s.count){
+      byte arg = (stage<<4)|(item<4? item: item-4);
+      switch(item){
+        case 0: telemetryLog(TELEM_PROF,arg,s.count); break;
+        case 1: telemetryLog(TELEM_PROF,arg,s.min); break;
+        case 2: telemetryLog(TELEM_PROF,arg,s.max); break;
+        case 3: telemetryLog(TELEM_PROF,arg,s.sum/s.count); break;
+        default: if(s.hist[item-4]) telemetryLog(TELEM_PROF_HIST,arg,s.hist[item-4]); break;
+      }
+    } else item = PROF_ITEMS-1; //skip the rest of an empty stage
+    if(item==PROF_ITEMS-1) memset(&s,0,sizeof(s)); //done with this stage
+    profDumpPos = (stage+1<PROF_STAGES || item<PROF_ITEMS-1? stage*PROF_ITEMS+item+1: -1);
+  }
+  return profDumpPos>=0;
+}
+
+#endif //ENABLE_PROFILER
@@ -0,0 +1,17 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+//Optional: if ENABLE_PROFILER is defined in config, each task loop() runs is timed, as is the latency from a press to its ctrlEvt,
+//as are the bytes each display frame sends over the bus, and a long hold of Alt dumps the results over telemetry (see profiler.cpp)
+
+#define PROF_STAGES 12 //scheduler tasks (see arduino-clock.ino), plus the two below
+#define PROF_LATENCY 10 //the stage for press-to-ctrlEvt latency
+#define PROF_BUS 11 //the stage for display bus bytes per frame (counted, rather than timed)
+
+#ifdef ENABLE_PROFILER
+void profRecord(byte stage, unsigned long us);
+void profDump();
+bool profCycle();
+#endif
+
+#endif
@@ -1,4 +1,4 @@
-#include <arduino.h>
+#include <Arduino.h>
 #include "arduino-clock.h"
 
 #ifdef RTC_DS3231 //see arduino-clock.ino Includes section
@@ -7,14 +7,41 @@
 #include <Wire.h> //Arduino - GNU LPGL - for I2C access to DS3231
 #include <DS3231.h> //NorthernWidget - The Unlicense - install in your Arduino IDE
 
+#include "i2cBus.h" //to take turns on the bus
+
 //RTC objects
 DS3231 ds3231; //an object to access the ds3231 specifically (temp, etc)
-RTClib rtc; //an object to access a snapshot of the ds3231 via rtc.now()
-DateTime tod; //stores the rtc.now() snapshot for several functions to use
+#define DS3231_ADDR 0x68
+DateTime tod; //stores the RTC snapshot for several functions to use (see rtcRead)
 byte todW; //stores the day of week (read separately from ds3231 dow counter)
+unsigned long todMillis = 0; //millis() at the start of the snapshot's second, as near as we can tell
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR //ESP32 ISRs must be in IRAM; means nothing elsewhere
+#endif
+
+#ifdef RTC_SQW_PIN
+  //If the DS3231's SQW output is connected, we set it to 1Hz and take it on an interrupt, so we only need to read the RTC
+  //once per second (rather than every loop, to find out whether the second has changed) – and we know exactly when the second started.
+  volatile bool rtcTick = 1; //set by rtcTickISR at the start of each second. Starts set, to take the first snapshot.
+  volatile unsigned long rtcTickMillis = 0; //millis() at the last tick
+  void IRAM_ATTR rtcTickISR(){
+    rtcTickMillis = millis(); rtcTick = 1;
+  }
+#else
+  byte todSecLast = 61; //to detect when polled snapshots reach a new second
+#endif
 
 void rtcInit(){
   Wire.begin();
+  #ifdef RTC_SQW_PIN
+    ds3231.enableOscillator(true,false,0); //SQW at 1Hz – this also clears INTCN, so the pin gives the square wave rather than alarm interrupts
+    pinMode(RTC_SQW_PIN,INPUT_PULLUP); //SQW is open drain
+    attachInterrupt(digitalPinToInterrupt(RTC_SQW_PIN),rtcTickISR,FALLING); //falling edge is when the seconds register updates
+  #endif
+  #ifdef TIMEBASE_32K
+    ds3231.enable32kHz(true); //for the chrono timebase – see timebase32k.cpp
+  #endif
 }
 void rtcSetTime(byte h, byte m, byte s){
   ds3231.setHour(h);
@@ -32,10 +59,70 @@ void rtcSetHour(byte h){ //used for DST forward/backward
   ds3231.setHour(h);
 }
 
-void rtcTakeSnap(){
+#ifdef ESP32_DUAL_CORE
+  //The bus task (on core 0) reads the RTC, per rtcPoll, and rtcTakeSnap (on core 1) takes its latest reading. The reading is guarded by
+  //a sequence count, which is odd while rtcPoll is writing it, so rtcTakeSnap can tell if it changed underneath it, and take it again.
+  DateTime busTod; byte busTodW = 0; unsigned long busTodMillis = 0; //the latest reading
+  volatile word busSeq = 0; //incremented before and after each reading is written
+  word busSeqTaken = 0; //busSeq, as of the reading rtcTakeSnap last took
+#endif
+
+byte rtcBCD(byte b){ return (b>>4)*10+(b&0x0F); } //"private"
+bool rtcRead(DateTime &t, byte &w, unsigned long &m, bool force){ //"private"
+  //Reads the RTC into t, w and m (per tod, todW, todMillis). Returns whether it did.
+  #ifdef RTC_SQW_PIN
+    //The snapshot only changes at the tick, so we only read the RTC then, unless forced
+    if(!rtcTick && !force) return 0;
+  #endif
+  if(!force && !i2cTake(I2C_RTC)) return 0; //not our turn on the bus – try again next pass (see i2cBus.cpp)
+  #ifdef RTC_SQW_PIN
+    noInterrupts(); rtcTick = 0; m = rtcTickMillis; interrupts();
+  #endif
+  //Read the time and weekday registers (0x00-0x06) in one burst, rather than via RTClib::now() and getDoW(), which take a transaction each
+  Wire.beginTransmission(DS3231_ADDR); Wire.write((uint8_t)0); Wire.endTransmission(false);
+  Wire.requestFrom((uint8_t)DS3231_ADDR,(uint8_t)7);
+  byte s = rtcBCD(Wire.read()&0x7F);
+  byte mi = rtcBCD(Wire.read());
+  byte hr = Wire.read();
+  if(hr&0x40) hr = rtcBCD(hr&0x1F)%12+(hr&0x20? 12: 0); //12-hour mode, with PM bit
+  else hr = rtcBCD(hr&0x3F);
+  w = (Wire.read()&0x07)-1; //ds3231 weekday is 1-index
+  byte d = rtcBCD(Wire.read());
+  byte mo = rtcBCD(Wire.read()&0x1F); //bit 7 is the century
+  byte y = rtcBCD(Wire.read());
+  t = DateTime(2000+y,mo,d,hr,mi,s);
+  #ifndef RTC_SQW_PIN
+    //Without the tick, the best we can do is when we first saw this second
+    if(t.second()!=todSecLast){ todSecLast = t.second(); m = millis(); }
+  #endif
+  return 1;
+}
+void rtcPoll(){
+  //On ESP32_DUAL_CORE, called by the bus task: reads the RTC, for rtcTakeSnap to take
+  #ifdef ESP32_DUAL_CORE
+    DateTime t; byte w; unsigned long m = busTodMillis;
+    if(!rtcRead(t,w,m,false)) return;
+    busSeq++; __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    busTod = t; busTodW = w; busTodMillis = m;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); busSeq++;
+  #endif
+}
+void rtcTakeSnap(bool force){
   //rtcGet functions pull from this snapshot - to ensure that code works off the same timestamp
-  tod = rtc.now();
-  todW = ds3231.getDoW()-1; //ds3231 weekday is 1-index
+  #ifdef ESP32_DUAL_CORE
+    //Take the bus task's latest reading, if there's a new one – unless forced, which reads the RTC directly, so is only for setup, before the bus task starts
+    if(force){ rtcRead(tod,todW,todMillis,true); return; }
+    word s = busSeq;
+    if(s==busSeqTaken) return; //nothing new
+    do {
+      s = busSeq; __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      tod = busTod; todW = busTodW; todMillis = busTodMillis;
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } while((s&1) || s!=busSeq); //it changed while we were taking it
+    busSeqTaken = s;
+  #else
+    rtcRead(tod,todW,todMillis,force);
+  #endif
 }
 int  rtcGetYear(){ return tod.year(); }
 byte rtcGetMonth(){ return tod.month(); }
@@ -45,7 +132,8 @@ int  rtcGetTOD(){ return tod.hour()*60+tod.minute(); }
 byte rtcGetHour(){ return tod.hour(); }
 byte rtcGetMinute(){ return tod.minute(); }
 byte rtcGetSecond(){ return tod.second(); }
+unsigned long rtcGetSecondStart(){ return todMillis; }
 
-byte rtcGetTemp(){ return ds3231.getTemperature()*100; }
+int rtcGetTemp(){ return ds3231.getTemperature()*100; }
 
 #endif //RTC_DS3231
\ No newline at end of file
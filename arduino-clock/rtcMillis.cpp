@@ -1,4 +1,4 @@
-#include <arduino.h>
+#include <Arduino.h>
 #include "arduino-clock.h"
 
 #ifdef RTC_MILLIS //see arduino-clock.ino Includes section
@@ -8,61 +8,89 @@
 ////////// FAKE RTC using millis //////////
 
 //snapshot of time of day
-unsigned long todMils = 0; //time of day in milliseconds
+//Kept broken down, and advanced with carry in rtcTakeSnap, so the getters don't have to divide
+byte todH = 0;
+byte todMi = 0;
+byte todS = 0;
+word todMs = 0;
+int todTOD = 0; //todH*60+todMi, per rtcGetTOD
 int todY = 2020;
 byte todM = 1;
 byte todD = 1;
 byte todW = 0;
 unsigned long millisAtTOD = 0; //reflects millis at snapshot
 
+#ifndef ANTI_DRIFT
+#define ANTI_DRIFT 0
+#endif
+#if ANTI_DRIFT
+long antiDriftFrac = 0; //anti-drift not yet applied, in thousandths of a ms
+#endif
+
 void rtcInit(){}
 void rtcSetTime(byte h, byte m, byte s){
-  todMils = (h*3600000)+(m*60000)+(s*1000);
+  todH = h; todMi = m; todS = s; todMs = 0; todTOD = h*60+m;
   millisAtTOD = millis();
+  #if ANTI_DRIFT
+  antiDriftFrac = 0;
+  #endif
   millisReset();
 }
 void rtcSetDate(int y, byte m, byte d, byte w){
   todY = y; todM = m; todD = d; todW = w;
 }
 void rtcSetHour(byte h){
-  todMils = (h*3600000)+(todMils%60000);
-  millisAtTOD = millis();
+  rtcTakeSnap(true); //bring the rest up to date first
+  todH = h; todTOD = h*60+todMi;
 }
 
-void rtcTakeSnap(){
+void rtcPoll(){} //there's no RTC hardware to read – rtcTakeSnap does it all
+void rtcTakeSnap(bool force){
+  //force has no effect here, since this is cheap to do every time
   unsigned long millisNow = millis();
-  //Increment todMils per the change in millis
-  todMils += millisNow-millisAtTOD;
-  
-  //Apply anti-drift
-  unsigned long drift = (abs(ANTI_DRIFT) * (millisNow-millisAtTOD))/1000;
-  if(ANTI_DRIFT>0) todMils += drift;
-  if(ANTI_DRIFT<0) todMils -= drift;
-  //any issues with data types/truncation here?
-  
-  //Update the millis snap
+  if(millisNow==millisAtTOD) return; //nothing to do – the usual case, since this is called every loop
+  //Advance per the change in millis
+  unsigned long el = millisNow-millisAtTOD;
   millisAtTOD = millisNow;
-  //Handle midnight rollover
-  //This may behave erratically if rtcTakeSnap() is not called for long enough that todMils rolls over,
-  //but this should not happen, because except for short hangs (eg wifi connect) we should be calling it at least 1/sec
-  if(todMils >= 86400000){
-    //the stopwatch doesn't care about date
-    // while(todMils >= 86400000) todMils = todMils - 86400000; //while is just to ensure it's below 86400000
-    // if(todD==daysInMonth(todY,todM)){ todD = 1; todM++; if(todM==13){ todM==1; todY++; } }
-    // else todD++;
-    // todW++; if(todW>6) todW=0;
+
+  #if ANTI_DRIFT
+  //Apply anti-drift (ANTI_DRIFT ms per sec, i.e. thousandths of a ms per ms) as whole ms, carrying the fraction – usually 0 or 1ms at a time
+  antiDriftFrac += (long)el*ANTI_DRIFT;
+  while(antiDriftFrac>=1000){ antiDriftFrac -= 1000; el++; }
+  while(antiDriftFrac<=-1000){ antiDriftFrac += 1000; el--; }
+  #endif
+
+  //Carry through the broken-down fields, one second at a time (usually none)
+  el += todMs;
+  while(el>=1000){
+    el -= 1000;
+    if(++todS<60) continue;
+    todS = 0;
+    if(++todMi==60){
+      todMi = 0;
+      if(++todH==24){ //midnight rollover
+        todH = 0;
+        //the stopwatch doesn't care about date
+        // if(todD==daysInMonth(todY,todM)){ todD = 1; todM++; if(todM==13){ todM==1; todY++; } }
+        // else todD++;
+        // todW++; if(todW>6) todW=0;
+      }
+    }
+    todTOD = todH*60+todMi;
   }
+  todMs = el;
 }
 
 int  rtcGetYear(){ return todY; }
 byte rtcGetMonth(){ return todM; }
 byte rtcGetDate(){ return todD; }
 byte rtcGetWeekday(){ return todW; }
-int  rtcGetTOD(){ return (todMils/1000)/60; }
-byte rtcGetHour(){ return (todMils/1000)/3600; }
-byte rtcGetMinute(){ return ((todMils/1000)/60)%60; }
-byte rtcGetSecond(){ return (todMils/1000)%60; }
+int  rtcGetTOD(){ return todTOD; }
+byte rtcGetHour(){ return todH; }
+byte rtcGetMinute(){ return todMi; }
+byte rtcGetSecond(){ return todS; }
+unsigned long rtcGetSecondStart(){ return millisAtTOD-todMs; }
 
-byte rtcGetTemp(){ return 1000; } //a fake response - ten degrees (1000 hundredths) forever
+int rtcGetTemp(){ return 1000; } //a fake response - ten degrees (1000 hundredths) forever
 
 #endif //RTC_MILLIS
\ No newline at end of file
@@ -8,7 +8,8 @@ void rtcSetTime(byte h, byte m, byte s);
 void rtcSetDate(int y, byte m, byte d, byte w);
 void rtcSetHour(byte h);
 
-void rtcTakeSnap();
+void rtcPoll();
+void rtcTakeSnap(bool force);
 
 int  rtcGetYear();
 byte rtcGetMonth();
@@ -18,7 +19,8 @@ int  rtcGetTOD();
 byte rtcGetHour();
 byte rtcGetMinute();
 byte rtcGetSecond();
+unsigned long rtcGetSecondStart();
 
-byte rtcGetTemp();
+int rtcGetTemp();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#include "telemetry.h"
+
+#if TELEMETRY_LEVEL //see arduino-clock.ino Includes section
+
+#include "input.h" //for getInputDropped
+
+#ifndef TELEMETRY_BAUD
+#define TELEMETRY_BAUD 115200
+#endif
+#ifndef TELEMETRY_QUEUE_SIZE
+#define TELEMETRY_QUEUE_SIZE 16 //must be a power of 2
+#endif
+#define TELEM_SYNC 0xA5
+
+//Events are queued as fixed-size records, which telemetryCycle sends only when the UART's transmit buffer has room,
+//so logging never waits on the UART – that matters most on the start/stop path. On the wire, each record is 8 bytes:
+//sync (0xA5), type, arg, val (4 bytes, little-endian), checksum (type+arg+val bytes, mod 256). See tools/telemetry_decode.py.
+struct TelemRec { byte type; byte arg; unsigned long val; };
+TelemRec telemQueue[TELEMETRY_QUEUE_SIZE];
+byte telemHead = 0; //count of records written
+byte telemTail = 0; //count of records sent
+unsigned long telemLost = 0; //count of records lost because the queue was full
+unsigned long telemLostSent = 0; //telemLost, as of the last TELEM_LOST record
+word telemDroppedSent = 0; //getInputDropped(), as of the last TELEM_DROPPED record
+
+void telemetryInit(){
+  Serial.begin(TELEMETRY_BAUD);
+}
+void telemetryLog(byte type, byte arg, unsigned long val){
+  //Queues a record. O(1), no I/O.
+  if((byte)(telemHead-telemTail)>=TELEMETRY_QUEUE_SIZE){ telemLost++; return; } //full
+  TelemRec &r = telemQueue[telemHead&(TELEMETRY_QUEUE_SIZE-1)];
+  r.type = type; r.arg = arg; r.val = val;
+  telemHead++;
+}
+bool telemetryBusy(){
+  //Whether there are records still to send
+  return telemHead!=telemTail;
+}
+byte telemetryRoom(){
+  //How many more records the queue can take
+  return TELEMETRY_QUEUE_SIZE-(byte)(telemHead-telemTail);
+}
+void telemetryCycle(){
+  //Called every loop: sends as many queued records as the UART can take without waiting
+  if(getInputDropped()!=telemDroppedSent){ telemDroppedSent = getInputDropped(); telemetryLog(TELEM_DROPPED,0,telemDroppedSent); }
+  if(telemLost!=telemLostSent && (byte)(telemHead-telemTail)<TELEMETRY_QUEUE_SIZE){ telemLostSent = telemLost; telemetryLog(TELEM_LOST,0,telemLostSent); }
+  while(telemTail!=telemHead && Serial.availableForWrite()>=8){
+    TelemRec &r = telemQueue[telemTail&(TELEMETRY_QUEUE_SIZE-1)];
+    byte frame[8] = {TELEM_SYNC, r.type, r.arg, (byte)r.val, (byte)(r.val>>8), (byte)(r.val>>16), (byte)(r.val>>24), 0};
+    for(byte i=1; i<7; i++) frame[7] += frame[i];
+    Serial.write(frame,8);
+    telemTail++;
+  }
+}
+
+#endif //TELEMETRY_LEVEL
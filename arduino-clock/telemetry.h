@@ -0,0 +1,33 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+//Optional: if TELEMETRY_LEVEL is defined in config, timer events are streamed over Serial as binary records (see telemetry.cpp)
+//0 = off, 1 = timer events (start/stop/clear/lap/runout) and lost events, 2 = also drift samples
+
+#ifndef TELEMETRY_LEVEL
+#define TELEMETRY_LEVEL 0
+#endif
+
+//Record types
+#define TELEM_START 1 //arg = channel, val = ms() at start (low 32 bits)
+#define TELEM_STOP 2 //arg = channel, val = duration (ms)
+#define TELEM_CLEAR 3 //arg = channel
+#define TELEM_LAP 4 //arg = lap number (low 8 bits), val = lap time (ms)
+#define TELEM_DRIFT 5 //val = millis() rate correction (2^-24 units, signed)
+#define TELEM_DROPPED 6 //val = input events dropped so far (see getInputDropped)
+#define TELEM_LOST 7 //val = telemetry records lost so far, because the queue was full
+#define TELEM_PROF 8 //arg = stage<<4 | field (0 = samples, 1 = min µs, 2 = max µs, 3 = mean µs), val = value (see profiler.cpp)
+#define TELEM_PROF_HIST 9 //arg = stage<<4 | bucket (times under 2^bucket µs), val = count (see profiler.cpp)
+#define TELEM_RUNOUT 10 //arg = channel, val = ms() at the countdown's deadline (low 32 bits)
+
+#if TELEMETRY_LEVEL
+void telemetryInit();
+void telemetryLog(byte type, byte arg, unsigned long val);
+void telemetryCycle();
+bool telemetryBusy();
+byte telemetryRoom();
+#else
+inline void telemetryLog(byte type, byte arg, unsigned long val){} //compiles out
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+#include <Arduino.h>
+#include "arduino-clock.h"
+
+#ifdef TIMEBASE_32K //see arduino-clock.ino Includes section
+
+#include "timebase32k.h"
+
+#ifndef RTC_DS3231
+#error "TIMEBASE_32K requires RTC_DS3231"
+#endif
+#if !defined(__AVR__) && !defined(ESP32)
+#error "TIMEBASE_32K is only supported on AVR and ESP32"
+#endif
+
+//The DS3231's 32.768kHz output comes from the same temperature-compensated oscillator as its seconds,
+//so counting it in hardware gives the chrono a timebase as accurate as the RTC, with ~30µs resolution.
+//The hardware counter is extended in its overflow/limit interrupt. Since 1000/32768 = 125/4096,
+//each full period of the counter is a whole number of ms, and ms is exact (never accumulates rounding).
+//rtcInit enables the output.
+
+#ifdef __AVR__
+  //On AVR, Timer1 counts the T1 pin (D5 on ATmega328P). This takes Timer1 from PWM on pins 9/10.
+  //16-bit counter: each overflow is 65536 ticks = 2000ms.
+  volatile unsigned long tbHigh = 0; //Timer1 overflows
+  ISR(TIMER1_OVF_vect){ tbHigh++; }
+
+  void tbInit(){
+    pinMode(5,INPUT_PULLUP); //32kHz is open drain
+    TCCR1A = 0;
+    TCCR1B = _BV(CS12)|_BV(CS11)|_BV(CS10); //normal mode, clock source T1 rising edge
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1); //clear any pending overflow
+    TIMSK1 = _BV(TOIE1);
+  }
+  unsigned long long tbMillis(){
+    uint8_t sreg = SREG; cli();
+    unsigned long h = tbHigh;
+    word l = TCNT1;
+    if((TIFR1&_BV(TOV1)) && l<0x8000) h++; //overflowed, but the ISR hasn't run yet
+    SREG = sreg;
+    return h*2000ULL+(((unsigned long)l*125)>>12);
+  }
+#endif //__AVR__
+
+#ifdef ESP32
+  //On ESP32, a PCNT unit counts TIMEBASE_32K_PIN. Its counter is only 16-bit signed, so it's limited
+  //at 16384 ticks = 500ms, where it resets to 0 and interrupts.
+  #include "driver/pcnt.h"
+  #include "soc/pcnt_struct.h"
+  #define TB_PCNT_LIM 16384
+  volatile unsigned long tbHigh = 0; //PCNT limit events
+  portMUX_TYPE tbMux = portMUX_INITIALIZER_UNLOCKED; //the ISR and tbMillis may be on different cores
+  void IRAM_ATTR tbISR(void *arg){
+    portENTER_CRITICAL_ISR(&tbMux);
+    if(PCNT.int_st.val & BIT(TB_PCNT_UNIT)){ tbHigh++; PCNT.int_clr.val = BIT(TB_PCNT_UNIT); }
+    portEXIT_CRITICAL_ISR(&tbMux);
+  }
+
+  void tbInit(){
+    pcnt_config_t cfg = {};
+    cfg.pulse_gpio_num = TIMEBASE_32K_PIN;
+    cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    cfg.channel = PCNT_CHANNEL_0;
+    cfg.unit = TB_PCNT_UNIT;
+    cfg.pos_mode = PCNT_COUNT_INC; //count rising edges only
+    cfg.neg_mode = PCNT_COUNT_DIS;
+    cfg.lctrl_mode = PCNT_MODE_KEEP;
+    cfg.hctrl_mode = PCNT_MODE_KEEP;
+    cfg.counter_h_lim = TB_PCNT_LIM;
+    cfg.counter_l_lim = 0;
+    pcnt_unit_config(&cfg);
+    gpio_pullup_en((gpio_num_t)TIMEBASE_32K_PIN); //32kHz is open drain
+    pcnt_set_filter_value(TB_PCNT_UNIT,100); //ignore glitches under 1.25µs (the 32kHz half-period is ~15µs)
+    pcnt_filter_enable(TB_PCNT_UNIT);
+    pcnt_event_enable(TB_PCNT_UNIT,PCNT_EVT_H_LIM);
+    pcnt_counter_pause(TB_PCNT_UNIT);
+    pcnt_counter_clear(TB_PCNT_UNIT);
+    pcnt_isr_register(tbISR,NULL,0,NULL); //our own handler (rather than the ISR service), so tbMillis can see a pending limit event
+    pcnt_intr_enable(TB_PCNT_UNIT);
+    pcnt_counter_resume(TB_PCNT_UNIT);
+  }
+  unsigned long long tbMillis(){
+    int16_t l;
+    portENTER_CRITICAL(&tbMux);
+    unsigned long h = tbHigh;
+    pcnt_get_counter_value(TB_PCNT_UNIT,&l);
+    if((PCNT.int_raw.val & BIT(TB_PCNT_UNIT)) && l<TB_PCNT_LIM/2) h++; //hit the limit, but the ISR hasn't run yet
+    portEXIT_CRITICAL(&tbMux);
+    return h*500ULL+(((unsigned long)l*125)>>12);
+  }
+#endif //ESP32
+
+#endif //TIMEBASE_32K
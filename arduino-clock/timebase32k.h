@@ -0,0 +1,15 @@
+#ifndef TIMEBASE_32K_H
+#define TIMEBASE_32K_H
+
+//Optional: if the DS3231's 32kHz output is connected (see config), ms() counts it rather than using millis()
+
+#if defined(TIMEBASE_32K) && defined(ESP32)
+  #ifndef TB_PCNT_UNIT
+  #define TB_PCNT_UNIT PCNT_UNIT_0 //the PCNT unit that counts it – must differ from ROT_PCNT_UNIT, if using a rotary encoder (see input.cpp)
+  #endif
+#endif
+
+void tbInit();
+unsigned long long tbMillis();
+
+#endif
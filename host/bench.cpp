@@ -0,0 +1,73 @@
+//Microbenchmarks: the hot paths of the sketch, timed on the host, and the bus bytes each display frame takes. Host times are only
+//good for comparing one build against another (an AVR is ~100x slower, and divides in software) – bus bytes carry over as they are.
+//Usage: bench-<config> [iterations]. See host/README.md.
+
+#include "sim.h"
+#include <stdio.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock BenchClock;
+double benchOverhead = 0; //ns per timed call with nothing in it, taken off each result
+
+template<class Prep, class Run> double benchTime(unsigned long n, Prep prep, Run run){ //"private"
+  //Times each call of run on its own, after prep (untimed) – returns the mean, in ns
+  double total = 0;
+  for(unsigned long i=0; i<n; i++){
+    prep(i);
+    BenchClock::time_point t0 = BenchClock::now();
+    run(i);
+    total += std::chrono::duration<double,std::nano>(BenchClock::now()-t0).count();
+  }
+  return total/n-benchOverhead;
+}
+void benchReport(const char *name, unsigned long n, double ns){ //"private"
+  printf("%-28s %10lu %10.1f ns\n",name,n,ns<0? 0: ns);
+}
+
+int main(int argc, char **argv){
+  unsigned long n = (argc>1? strtoul(argv[1],0,10): 100000);
+  if(!n) n = 1;
+  simBoot();
+  benchOverhead = benchTime(n,[](unsigned long){},[](unsigned long){});
+  printf("%-28s %10s %10s\n","","calls","per call");
+
+  //updateDisplay, on a running chrono, 10ms on each time – so the formatter steps, and the centiseconds change
+  simSet(CTRL_SEL,1); simRun(2000);
+  benchReport("updateDisplay (running)",n,benchTime(n,[](unsigned long){ halAdvance(10000); },[](unsigned long){ updateDisplay(); }));
+  simSet(CTRL_SEL,0); simRun(2000);
+  benchReport("updateDisplay (stopped)",n,benchTime(n,[](unsigned long){},[](unsigned long){ updateDisplay(); }));
+
+  //The frame layer's staging: a value split into digits, and a pair already split
+  benchReport("editDisplay",n,benchTime(n,[](unsigned long){},[](unsigned long i){ editDisplay(i%10000,0,3,true,false); }));
+  benchReport("editDisplayPair",n,benchTime(n,[](unsigned long){},[](unsigned long i){ editDisplayPair(i%10,(i/10)%10,0,true,false); }));
+  benchReport("cycleDisplay (changed)",n,benchTime(n,[](unsigned long i){ editDisplayPair(i%10,(i/10)%10,2,true,false); displayPublish(); },
+    [](unsigned long){ cycleDisplay(2,0,0,0); }));
+  benchReport("cycleDisplay (unchanged)",n,benchTime(n,[](unsigned long){},[](unsigned long){ cycleDisplay(2,0,0,0); }));
+
+  //checkBtn, per poll: Sel idle, and Sel held (after its press) – a ms on each time
+  benchReport("checkBtn (idle)",n,benchTime(n,[](unsigned long){ halAdvance(1000); },[](unsigned long){ checkBtn(CTRL_SEL,0,millis()); }));
+  checkBtn(CTRL_SEL,1,millis()); inputDrain();
+  benchReport("checkBtn (held)",n,benchTime(n,[](unsigned long){ halAdvance(1000); },[](unsigned long){ checkBtn(CTRL_SEL,1,millis()); }));
+  halAdvance(10000); checkBtn(CTRL_SEL,0,millis()); inputDrain();
+
+  //millisCheckDrift, on a new RTC second 30s after the last
+  benchReport("millisCheckDrift",n,benchTime(n,[](unsigned long){ halAdvance(30000000UL); rtcTakeSnap(true); },[](unsigned long){ millisCheckDrift(); }));
+  benchReport("ms()",n,benchTime(n,[](unsigned long){ halAdvance(1000); },[](unsigned long){ ms(); }));
+
+  //A pass of the task loop, with nothing due, and with a chrono running
+  benchReport("loop (idle)",n,benchTime(n,[](unsigned long){ halAdvance(100); },[](unsigned long){ loop(); }));
+  simSet(CTRL_SEL,1); simRun(2000);
+  benchReport("loop (running)",n,benchTime(n,[](unsigned long){ halAdvance(100); },[](unsigned long){ loop(); }));
+
+  //Bus bytes per display frame, over 10s of the running chrono
+  unsigned long frames = 0; unsigned long total = 0; unsigned long most = 0;
+  for(unsigned long long until=halMicros()+10000000ULL; halMicros()<until; ){
+    unsigned long was = simDisplayBytes();
+    simPass(100);
+    unsigned long b = simDisplayBytes()-was;
+    if(!b) continue;
+    frames++; total += b; if(b>most) most = b;
+  }
+  printf("display bus bytes per frame: %.2f mean, %lu max, over %lu frames\n",frames? (double)total/frames: 0,most,frames);
+  return 0;
+}
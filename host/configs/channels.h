@@ -0,0 +1,11 @@
+//Host build: the default config with four independent channels – Sel, Alt, Up and Dn each start/stop their own
+
+#include "../../arduino-clock/configs/led7segHT-avr.h"
+
+#define TIMER_CHANNELS 4
+#undef CTRL_ALT
+#define CTRL_ALT A0
+#undef CTRL_UP
+#define CTRL_UP 4
+#undef CTRL_DN
+#define CTRL_DN 5
@@ -0,0 +1,13 @@
+//Host build: the default config counting down, beeping at zero, with a rotary encoder on Up/Dn to set the duration
+
+#include "../../arduino-clock/configs/led7segHT-avr.h"
+
+#define TIMER_COUNTDOWN 5
+#define TIMER_SIGNAL 0
+#define PIEZO_PIN 9
+#undef INPUT_UPDN_BUTTONS
+#define INPUT_UPDN_ROTARY
+#undef CTRL_UP
+#define CTRL_UP 4
+#undef CTRL_DN
+#define CTRL_DN 5
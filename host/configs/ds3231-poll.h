@@ -0,0 +1,5 @@
+//Host build: as ds3231.h, but with the DS3231 polled rather than ticking on SQW
+
+#include "ds3231.h"
+
+#undef RTC_SQW_PIN
@@ -0,0 +1,12 @@
+//Host build: the default config with a DS3231 ticking on SQW, plus Alt (for laps), persistence and telemetry
+
+#include "../../arduino-clock/configs/led7segHT-avr.h"
+
+#undef RTC_MILLIS
+#undef ANTI_DRIFT
+#define RTC_DS3231
+#define RTC_SQW_PIN 2
+#undef CTRL_ALT
+#define CTRL_ALT A0
+#define PERSIST_STATE
+#define TELEMETRY_LEVEL 2
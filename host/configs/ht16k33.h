@@ -0,0 +1,3 @@
+//Host build: the default config as shipped – HT16K33 4-digit 7-segment, fake RTC, Sel only
+
+#include "../../arduino-clock/configs/led7segHT-avr.h"
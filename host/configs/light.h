@@ -0,0 +1,6 @@
+//Host build: the default config with a VEML7700 setting the display brightness
+
+#include "../../arduino-clock/configs/led7segHT-avr.h"
+
+#define LIGHTSENSOR_VEML7700
+#define LIGHTSENSOR
@@ -0,0 +1,3 @@
+//Host build: the MAX7219 config as shipped – 4-matrix chain (bit-banged on its pins), fake RTC, Sel only
+
+#include "../../arduino-clock/configs/ledmatrixMAX-avr.h"
@@ -0,0 +1,6 @@
+#ifndef ADAFRUIT_GFX_H
+#define ADAFRUIT_GFX_H
+
+//Mock of Adafruit GFX for the host build – Adafruit_LEDBackpack.h needs nothing from it
+
+#endif //ADAFRUIT_GFX_H
@@ -0,0 +1,22 @@
+#ifndef ADAFRUIT_LEDBACKPACK_H
+#define ADAFRUIT_LEDBACKPACK_H
+
+//Mock of Adafruit LED Backpack's 7-segment driver for the host build – just what dispHT16K33.cpp uses. Like the real one,
+//it keeps displaybuffer and sends it (and setup) over Wire, so what ends up in the HT16K33 model is what the hardware would show.
+
+#include <Arduino.h>
+
+class Adafruit_7segment {
+public:
+  uint16_t displaybuffer[8];
+  bool begin(uint8_t addr=0x70);
+  void setBrightness(uint8_t b);
+  void writeDisplay();
+  void clear(){ memset(displaybuffer,0,sizeof(displaybuffer)); }
+  void writeDigitRaw(uint8_t d, uint8_t bitmask){ if(d<8) displaybuffer[d] = bitmask; }
+  void writeDigitNum(uint8_t d, uint8_t num, bool dot=false);
+private:
+  uint8_t addr = 0x70;
+};
+
+#endif //ADAFRUIT_LEDBACKPACK_H
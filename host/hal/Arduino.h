@@ -0,0 +1,84 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+//Mock Arduino core for the host build (see host/README.md) – just what the sketch uses, backed by the simulation in hal.cpp.
+//There's no __AVR__ or ESP32 here, so the sketch takes its generic paths (digitalRead, no sleep, no hardware deadline timer).
+//Note unsigned long is 64-bit on the host, so millis()/micros() never wrap.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define NOT_AN_INTERRUPT -1
+#define DEC 10
+#define HEX 16
+
+static const uint8_t A0 = 14, A1 = 15, A2 = 16, A3 = 17, A4 = 18, A5 = 19, A6 = 20, A7 = 21; //as on a Nano – A6/A7 are analog-only
+static const uint8_t SS = 10, MOSI = 11, MISO = 12, SCK = 13;
+#define HAL_PINS 32 //pins 0 to HAL_PINS-1 exist
+#define E2END 1023 //last EEPROM address, as on the ATmega328P
+
+#define bit(b) (1UL<<(b))
+#define bitRead(value,bit) (((value)>>(bit))&0x01)
+#define bitSet(value,bit) ((value) |= (1UL<<(bit)))
+#define bitClear(value,bit) ((value) &= ~(1UL<<(bit)))
+#define bitWrite(value,bit,bitvalue) ((bitvalue)? bitSet(value,bit): bitClear(value,bit))
+#define _BV(b) (1<<(b))
+
+#define F(s) (s)
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t*)(a))
+#define pgm_read_word(a) (*(const uint16_t*)(a))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms); //advances the clock
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+int analogRead(uint8_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+void tone(uint8_t pin, unsigned int freq, unsigned long dur=0);
+void noTone(uint8_t pin);
+
+int digitalPinToInterrupt(int pin); //every pin has one
+void attachInterrupt(int irq, void (*isr)(), int mode);
+void detachInterrupt(int irq);
+void noInterrupts();
+void interrupts();
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud);
+  operator bool(){ return 1; }
+  size_t print(const char *s);
+  size_t print(long n, int base=DEC);
+  size_t println(const char *s);
+  size_t println(long n, int base=DEC);
+  size_t println();
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t len);
+  int availableForWrite();
+  void flush(){}
+};
+extern HardwareSerial Serial;
+
+#endif //ARDUINO_H
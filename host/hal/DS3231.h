@@ -0,0 +1,36 @@
+#ifndef DS3231_H
+#define DS3231_H
+
+//Mock of NorthernWidget's DS3231 library for the host build – just what rtcDS3231.cpp uses. Setters go to the DS3231 model's
+//registers over the mock Wire (see wire.cpp), so they're counted as bus traffic like the real thing.
+
+#include <Arduino.h>
+
+class DateTime {
+public:
+  DateTime(uint16_t y=2000, uint8_t mo=1, uint8_t d=1, uint8_t h=0, uint8_t mi=0, uint8_t s=0): y(y), mo(mo), d(d), h(h), mi(mi), s(s) {}
+  uint16_t year() const { return y; }
+  uint8_t month() const { return mo; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return h; }
+  uint8_t minute() const { return mi; }
+  uint8_t second() const { return s; }
+private:
+  uint16_t y; uint8_t mo, d, h, mi, s;
+};
+
+class DS3231 {
+public:
+  void enableOscillator(bool TF, bool battery, byte frequency); //TF turns SQW on (at 1Hz, per frequency 0)
+  void enable32kHz(bool TF){}
+  void setSecond(byte s);
+  void setMinute(byte m);
+  void setHour(byte h);
+  void setDoW(byte w);
+  void setDate(byte d);
+  void setMonth(byte m);
+  void setYear(byte y);
+  float getTemperature();
+};
+
+#endif //DS3231_H
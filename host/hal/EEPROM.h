@@ -0,0 +1,20 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+//Mock EEPROM for the host build: a RAM array, with writes counted
+
+#include <Arduino.h>
+
+#define HAL_EEPROM_SIZE (E2END+1)
+
+class EEPROMClass {
+public:
+  void begin(size_t size){}
+  uint8_t read(int addr);
+  void write(int addr, uint8_t val);
+  void update(int addr, uint8_t val){ if(read(addr)!=val) write(addr,val); }
+  bool commit(){ return 1; }
+};
+extern EEPROMClass EEPROM;
+
+#endif //EEPROM_H
@@ -0,0 +1,23 @@
+#ifndef SPI_H
+#define SPI_H
+
+//Mock SPI for the host build: bytes go to the MAX7219 chain model in hal.cpp, latched by its CS pin
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode){}
+};
+class SPIClass {
+public:
+  void begin();
+  void beginTransaction(SPISettings s){}
+  uint8_t transfer(uint8_t b);
+  void endTransaction(){}
+};
+extern SPIClass SPI;
+
+#endif //SPI_H
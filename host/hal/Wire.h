@@ -0,0 +1,22 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+//Mock Wire for the host build: transactions go to the device models in wire.cpp (HT16K33, DS3231), and are counted per address
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+  void begin();
+  void setClock(unsigned long hz);
+  void beginTransmission(uint8_t addr);
+  size_t write(uint8_t b);
+  uint8_t endTransmission(bool stop=1);
+  uint8_t requestFrom(uint8_t addr, uint8_t len);
+  uint8_t requestFrom(int addr, int len){ return requestFrom((uint8_t)addr,(uint8_t)len); }
+  int available();
+  int read();
+};
+extern TwoWire Wire;
+
+#endif //WIRE_H
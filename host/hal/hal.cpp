@@ -0,0 +1,241 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "hal.h"
+#include "halInternal.h"
+
+//The simulated hardware: a clock that only moves when halAdvance moves it, pins with interrupts, and the device models
+//that aren't on I2C (the MAX7219 chain, EEPROM, Serial) – plus the DS3231's timekeeping, which wire.cpp reads registers from.
+
+HardwareSerial Serial;
+SPIClass SPI;
+EEPROMClass EEPROM;
+
+////////// Clock //////////
+
+unsigned long long halUs = 0; //the clock, µs since start
+
+void halRTCTicks(unsigned long long until); //"private"
+
+unsigned long millis(){ return halUs/1000; }
+unsigned long micros(){ return halUs; }
+void delay(unsigned long ms){ halAdvance(ms*1000); }
+void delayMicroseconds(unsigned int us){ halAdvance(us); }
+unsigned long long halMicros(){ return halUs; }
+void halAdvance(unsigned long us){
+  unsigned long long until = halUs+us;
+  halRTCTicks(until); //moves the clock to each SQW edge on the way, if any
+  halUs = until;
+}
+
+////////// Pins and interrupts //////////
+
+struct HalPin {
+  byte mode; //per pinMode
+  bool level; //as written, if an output, else as driven
+  int analog; //per halSetAnalog
+  unsigned int tone; //per tone()
+  void (*isr)(); //per attachInterrupt
+  byte isrMode;
+  bool pending; //fired while interrupts were off
+};
+HalPin halPins[HAL_PINS];
+bool halIntsOff = 0;
+struct HalPinInit { HalPinInit(){ for(byte p=0; p<HAL_PINS; p++){ halPins[p].level = 1; halPins[p].analog = 1023; } } } halPinInit; //float high
+
+void pinMode(uint8_t pin, uint8_t mode){ if(pin<HAL_PINS) halPins[pin].mode = mode; }
+int digitalRead(uint8_t pin){ return pin<HAL_PINS? halPins[pin].level: 0; }
+int analogRead(uint8_t pin){ return pin<HAL_PINS? halPins[pin].analog: 0; }
+void tone(uint8_t pin, unsigned int freq, unsigned long dur){ if(pin<HAL_PINS) halPins[pin].tone = freq; }
+void noTone(uint8_t pin){ if(pin<HAL_PINS) halPins[pin].tone = 0; }
+
+int digitalPinToInterrupt(int pin){ return (pin>=0 && pin<HAL_PINS)? pin: NOT_AN_INTERRUPT; }
+void attachInterrupt(int irq, void (*isr)(), int mode){ if(irq>=0 && irq<HAL_PINS){ halPins[irq].isr = isr; halPins[irq].isrMode = mode; } }
+void detachInterrupt(int irq){ if(irq>=0 && irq<HAL_PINS) halPins[irq].isr = 0; }
+void noInterrupts(){ halIntsOff = 1; }
+void interrupts(){
+  halIntsOff = 0;
+  for(byte p=0; p<HAL_PINS; p++) if(halPins[p].pending){ halPins[p].pending = 0; if(halPins[p].isr) halPins[p].isr(); }
+}
+
+void halPinChange(byte pin, bool level){ //"private"
+  //Sets the pin's level, and fires its interrupt if the change matches – or leaves it pending, if interrupts are off
+  HalPin &p = halPins[pin];
+  if(p.level==level) return;
+  p.level = level;
+  if(!p.isr) return;
+  if(p.isrMode==CHANGE || (p.isrMode==FALLING && !level) || (p.isrMode==RISING && level)){
+    if(halIntsOff) p.pending = 1; else p.isr();
+  }
+}
+void halSetPin(byte pin, bool level){ if(pin<HAL_PINS) halPinChange(pin,level); }
+bool halPin(byte pin){ return pin<HAL_PINS && halPins[pin].level; }
+void halSetAnalog(byte pin, int val){ if(pin<HAL_PINS) halPins[pin].analog = val; }
+unsigned int halTone(byte pin){ return pin<HAL_PINS? halPins[pin].tone: 0; }
+
+////////// MAX7219 chain //////////
+
+//Bytes shifted in while CS is low are latched on its rising edge: the last two per chip, the last pair into the first chip
+byte halMaxCS = 255; //per halMAX7219Attach – 255 if none
+byte halMaxChips = 0;
+byte halMaxRegs[8][16]; //[chip][reg]
+std::vector<byte> halMaxShifted; //since CS went low
+unsigned long halSPIByteCount = 0;
+unsigned long halSPILatchCount = 0;
+
+void halMAX7219Attach(byte csPin, byte chips){ halMaxCS = csPin; halMaxChips = (chips>8? 8: chips); }
+byte halMAX7219Reg(byte chip, byte reg){ return (chip<8 && reg<16)? halMaxRegs[chip][reg]: 0; }
+void halShift(byte b){ halSPIByteCount++; halMaxShifted.push_back(b); }
+
+void digitalWrite(uint8_t pin, uint8_t val){
+  if(pin>=HAL_PINS) return;
+  bool was = halPins[pin].level;
+  halPins[pin].level = val;
+  if(pin!=halMaxCS || was==(bool)val) return;
+  if(!val){ halMaxShifted.clear(); return; } //CS low: start shifting
+  halSPILatchCount++;
+  size_t n = halMaxShifted.size()/2;
+  for(size_t k=0; k<n && k<halMaxChips; k++){ //k pairs back from the last
+    byte reg = halMaxShifted[(n-1-k)*2]; byte v = halMaxShifted[(n-1-k)*2+1];
+    if(reg && reg<16) halMaxRegs[k][reg] = v; //0 is no-op
+  }
+}
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val){
+  if(bitOrder==LSBFIRST){ byte r = 0; for(byte i=0; i<8; i++) if(val&bit(i)) r |= 0x80>>i; val = r; }
+  halShift(val);
+}
+void SPIClass::begin(){}
+uint8_t SPIClass::transfer(uint8_t b){ halShift(b); return 0; }
+
+unsigned long halSPIBytes(){ return halSPIByteCount; }
+unsigned long halSPILatches(){ return halSPILatchCount; }
+void halBusClear(){ halSPIByteCount = 0; halSPILatchCount = 0; halI2CClear(); }
+
+////////// DS3231 timekeeping //////////
+
+//Its time is seconds since 2000-01-01, as of halRTCUs, plus the µs since then scaled by its rate. Registers are worked out from that when read.
+long double halRTCBase = 0; //seconds since 2000-01-01, at halRTCUs
+unsigned long long halRTCUs = 0;
+long double halRTCScale = 1; //seconds it counts per second of micros()
+long double halRTCStart = 0; //halRTCBase, at start – for halRTCElapsed
+byte halRTCDoW = 0; //added to the day count, per setDoW
+byte halRTCSQWPin = 255; //per halRTCConnectSQW
+bool halRTCSQWOn = 0; //per halRTCSQWEnable
+long long halRTCHalf = 0; //for SQW: the latest half second passed
+
+long double halRTCNow(unsigned long long us){ return halRTCBase+(long double)(us-halRTCUs)*1e-6L*halRTCScale; } //"private"
+void halRTCRebase(long double secs){ //"private"
+  //Sets its time as of now, which the SQW edges go on from
+  halRTCBase = secs; halRTCUs = halUs;
+  halRTCHalf = (long long)floorl(secs*2);
+}
+void halRTCTicks(unsigned long long until){
+  //Walks the clock through each SQW edge up to until: falling at each whole second, rising half way between
+  if(!halRTCSQWOn || halRTCSQWPin>=HAL_PINS) return;
+  for(;;){
+    long double at = (((long double)(halRTCHalf+1))/2-halRTCBase)/halRTCScale*1e6L; //µs after halRTCUs
+    unsigned long long us = halRTCUs+(unsigned long long)ceill(at);
+    if(us>until) return;
+    if(us>halUs) halUs = us;
+    halRTCHalf++;
+    halPinChange(halRTCSQWPin,halRTCHalf&1);
+  }
+}
+void halRTCSQWEnable(bool on){
+  halRTCSQWOn = on;
+  halRTCRebase(halRTCNow(halUs));
+  if(halRTCSQWPin<HAL_PINS) halPinChange(halRTCSQWPin,halRTCHalf&1);
+}
+void halRTCConnectSQW(byte pin){ halRTCSQWPin = pin; }
+void halRTCRate(double ppm){ halRTCRebase(halRTCNow(halUs)); halRTCScale = 1+(long double)ppm*1e-6L; }
+void halRTCStep(long secs){ halRTCRebase(halRTCNow(halUs)+secs); halRTCStart += secs; }
+long halRTCSeconds(){ return (long)floorl(halRTCNow(halUs)); }
+double halRTCElapsed(){ return (double)(halRTCNow(halUs)-halRTCStart); }
+
+const byte halMonthDays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+struct HalDate { int y; byte mo, d, h, mi, s; long days; };
+HalDate halDate(long secs){ //"private"
+  HalDate t; t.days = secs/86400; long r = secs%86400;
+  t.h = r/3600; t.mi = (r/60)%60; t.s = r%60;
+  long days = t.days; t.y = 2000;
+  for(;;){ int len = (t.y%4? 365: 366); if(days<len) break; days -= len; t.y++; }
+  for(t.mo=1; ; t.mo++){ int len = halMonthDays[t.mo-1]+(t.mo==2 && t.y%4==0); if(days<len) break; days -= len; }
+  t.d = days+1;
+  return t;
+}
+long halSecs(const HalDate &t){ //"private"
+  long days = 0;
+  for(int y=2000; y<t.y; y++) days += (y%4? 365: 366);
+  for(byte m=1; m<t.mo; m++) days += halMonthDays[m-1]+(m==2 && t.y%4==0);
+  days += t.d-1;
+  return days*86400+t.h*3600L+t.mi*60L+t.s;
+}
+void halRTCSet(int y, byte mo, byte d, byte h, byte mi, byte s){
+  HalDate t; t.y = y; t.mo = mo; t.d = d; t.h = h; t.mi = mi; t.s = s;
+  halRTCRebase(halSecs(t)); halRTCStart = halRTCBase;
+}
+byte halBCD(byte v){ return ((v/10)<<4)|(v%10); } //"private"
+byte halUnBCD(byte b){ return (b>>4)*10+(b&0x0F); } //"private"
+byte halRTCReg(byte reg){
+  HalDate t = halDate((long)floorl(halRTCNow(halUs)));
+  switch(reg){
+    case 0: return halBCD(t.s);
+    case 1: return halBCD(t.mi);
+    case 2: return halBCD(t.h); //24-hour
+    case 3: return (t.days+halRTCDoW)%7+1;
+    case 4: return halBCD(t.d);
+    case 5: return halBCD(t.mo);
+    case 6: return halBCD(t.y-2000);
+    case 0x0E: return (halRTCSQWOn? 0: bit(2)); //INTCN clear while SQW is on
+    case 0x11: return 25; //°C
+    default: return 0;
+  }
+}
+void halRTCSetReg(byte reg, byte val){
+  //Writing a time register sets that field, and (like the real thing) writing the seconds restarts the second
+  long double now = halRTCNow(halUs);
+  long secs = (long)floorl(now); long double frac = now-secs;
+  HalDate t = halDate(secs);
+  switch(reg){
+    case 0: t.s = halUnBCD(val&0x7F); frac = 0; break;
+    case 1: t.mi = halUnBCD(val); break;
+    case 2: t.h = halUnBCD(val&0x3F); break;
+    case 3: halRTCDoW = ((val&7)+6-t.days%7)%7; return; //the day of week is just a counter, so it's an offset from the day count
+    case 4: t.d = halUnBCD(val); break;
+    case 5: t.mo = halUnBCD(val&0x1F); break;
+    case 6: t.y = 2000+halUnBCD(val); break;
+    case 0x0E: halRTCSQWEnable(!(val&bit(2))); return;
+    default: return;
+  }
+  halRTCRebase(halSecs(t)+frac);
+}
+
+////////// EEPROM //////////
+
+byte halEEPROM[HAL_EEPROM_SIZE];
+unsigned long halEEPROMWriteCount = 0;
+struct HalEEPROMInit { HalEEPROMInit(){ memset(halEEPROM,0xFF,sizeof(halEEPROM)); } } halEEPROMInit; //erased
+uint8_t EEPROMClass::read(int addr){ return (addr>=0 && addr<HAL_EEPROM_SIZE)? halEEPROM[addr]: 0xFF; }
+void EEPROMClass::write(int addr, uint8_t val){ if(addr>=0 && addr<HAL_EEPROM_SIZE){ halEEPROM[addr] = val; halEEPROMWriteCount++; } }
+unsigned long halEEPROMWrites(){ return halEEPROMWriteCount; }
+
+////////// Serial //////////
+
+std::vector<byte> halSerialOut;
+void HardwareSerial::begin(unsigned long baud){}
+size_t HardwareSerial::write(uint8_t b){ halSerialOut.push_back(b); return 1; }
+size_t HardwareSerial::write(const uint8_t *buf, size_t len){ halSerialOut.insert(halSerialOut.end(),buf,buf+len); return len; }
+size_t HardwareSerial::print(const char *s){ return write((const uint8_t*)s,strlen(s)); }
+size_t HardwareSerial::print(long n, int base){
+  char buf[24]; snprintf(buf,sizeof(buf),base==HEX? "%lX": "%ld",n);
+  return print(buf);
+}
+size_t HardwareSerial::println(const char *s){ return print(s)+println(); }
+size_t HardwareSerial::println(long n, int base){ return print(n,base)+println(); }
+size_t HardwareSerial::println(){ return print("\r\n"); }
+int HardwareSerial::availableForWrite(){ return 63; } //as if the UART keeps up
+size_t halSerialLen(){ return halSerialOut.size(); }
+const byte *halSerialData(){ return halSerialOut.data(); }
@@ -0,0 +1,54 @@
+#ifndef HAL_H
+#define HAL_H
+
+//Control and inspection of the mock hardware, for the host scenarios and benchmarks (see host/README.md).
+//The sketch only sees the Arduino-side headers; this is the other side of them.
+
+#include <Arduino.h>
+
+//Time – the clock only moves when we move it
+void halAdvance(unsigned long us); //moves the clock forward by us, firing any RTC ticks on the way
+unsigned long long halMicros(); //the clock, µs since start
+
+//Pins – inputs float high (as if pulled up) until driven
+void halSetPin(byte pin, bool level); //drives an input pin, firing any interrupt attached to it
+bool halPin(byte pin); //a pin's level – as written, if an output, else as driven
+void halSetAnalog(byte pin, int val); //what analogRead returns for pin (default 1023)
+unsigned int halTone(byte pin); //the frequency tone() is playing on pin, 0 if none
+
+//Bus traffic – bytes on the wire, including each I2C address byte
+unsigned long halI2CBytes(byte addr);
+unsigned long halI2CTransactions(byte addr);
+unsigned long halSPIBytes(); //whether by SPI or shiftOut
+unsigned long halSPILatches(); //CS rising edges on the MAX7219 chain
+void halBusClear(); //zeroes the counts
+unsigned long halI2CClock(); //per Wire.setClock
+
+//HT16K33 (at any address 0x70-0x77)
+word halHT16K33Row(byte addr, byte row); //a 16-bit row of its display RAM
+int halHT16K33Digit(byte addr, byte pos); //the digit shown at display position pos (the colon row is skipped): 0-9, -1 if blank, -2 if anything else
+bool halHT16K33On(byte addr); //whether its display is on (rather than in standby)
+byte halHT16K33Brightness(byte addr);
+unsigned long halHT16K33BrightnessSets(byte addr); //how many times its brightness has been set
+
+//VEML7700 (at 0x10) – measures whatever lux it's given, at the gain and integration time the sketch sets
+void halVEML7700Lux(double lux);
+
+//MAX7219 chain – shifted in over SPI or shiftOut, and latched on rising CS
+void halMAX7219Attach(byte csPin, byte chips);
+byte halMAX7219Reg(byte chip, byte reg); //chip 0 is the first in the chain
+
+//DS3231 (at 0x68) – it keeps its own time, at its own rate, and optionally ticks a SQW pin at 1Hz
+void halRTCSet(int y, byte mo, byte d, byte h, byte mi, byte s); //at the start of that second
+void halRTCRate(double ppm); //how fast it runs compared to micros(), from now on – positive if faster
+void halRTCStep(long secs); //jumps its time, as if set behind the sketch's back – not counted in halRTCElapsed
+void halRTCConnectSQW(byte pin); //drives pin from SQW, once the sketch enables it (falling at each new second, rising half way through)
+long halRTCSeconds(); //its time, in whole seconds since 2000-01-01
+double halRTCElapsed(); //seconds it has counted since start, with the fraction
+
+//EEPROM and Serial
+unsigned long halEEPROMWrites();
+size_t halSerialLen(); //bytes sent over Serial
+const byte *halSerialData();
+
+#endif //HAL_H
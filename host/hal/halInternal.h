@@ -0,0 +1,14 @@
+#ifndef HAL_INTERNAL_H
+#define HAL_INTERNAL_H
+
+//Between the mock's own modules: hal.cpp keeps the clock, pins and device state, and wire.cpp and libs.cpp talk to it through these
+
+#include <Arduino.h>
+
+byte halRTCReg(byte reg); //DS3231 register, as of now
+void halRTCSetReg(byte reg, byte val);
+void halRTCSQWEnable(bool on);
+void halShift(byte b); //a byte shifted out to the MAX7219 chain, by SPI or shiftOut
+void halI2CClear(); //zeroes the I2C counts, for halBusClear
+
+#endif //HAL_INTERNAL_H
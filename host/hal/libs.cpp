@@ -0,0 +1,53 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <DS3231.h>
+#include <Adafruit_LEDBackpack.h>
+#include "halInternal.h"
+
+//The library mocks: each talks to the device models the way the real library does, so the bus counts stay honest.
+
+////////// DS3231 //////////
+
+#define HAL_DS3231_ADDR 0x68
+void halDS3231Write(byte reg, byte val){ //"private"
+  Wire.beginTransmission(HAL_DS3231_ADDR); Wire.write(reg); Wire.write(val); Wire.endTransmission();
+}
+byte halToBCD(byte v){ return ((v/10)<<4)|(v%10); } //"private"
+void DS3231::enableOscillator(bool TF, bool battery, byte frequency){
+  halDS3231Write(0x0E,TF? (frequency&3)<<3: bit(2)); //INTCN clear gives the square wave
+}
+void DS3231::setSecond(byte s){ halDS3231Write(0x00,halToBCD(s)); }
+void DS3231::setMinute(byte m){ halDS3231Write(0x01,halToBCD(m)); }
+void DS3231::setHour(byte h){ halDS3231Write(0x02,halToBCD(h)); } //24-hour
+void DS3231::setDoW(byte w){ halDS3231Write(0x03,w); }
+void DS3231::setDate(byte d){ halDS3231Write(0x04,halToBCD(d)); }
+void DS3231::setMonth(byte m){ halDS3231Write(0x05,halToBCD(m)); }
+void DS3231::setYear(byte y){ halDS3231Write(0x06,halToBCD(y)); }
+float DS3231::getTemperature(){ return halRTCReg(0x11); }
+
+////////// Adafruit_7segment //////////
+
+static const uint8_t numbertable[10] = {0x3F,0x06,0x5B,0x4F,0x66,0x6D,0x7D,0x07,0x7F,0x6F};
+bool Adafruit_7segment::begin(uint8_t a){
+  addr = a;
+  Wire.begin();
+  Wire.beginTransmission(addr); Wire.write((uint8_t)0x21); Wire.endTransmission(); //oscillator on
+  Wire.beginTransmission(addr); Wire.write((uint8_t)0x81); Wire.endTransmission(); //display on, no blink
+  setBrightness(15);
+  clear(); writeDisplay();
+  return 1;
+}
+void Adafruit_7segment::setBrightness(uint8_t b){
+  if(b>15) b = 15;
+  Wire.beginTransmission(addr); Wire.write((uint8_t)(0xE0|b)); Wire.endTransmission();
+}
+void Adafruit_7segment::writeDisplay(){
+  Wire.beginTransmission(addr);
+  Wire.write((uint8_t)0x00);
+  for(byte i=0; i<8; i++){ Wire.write((uint8_t)(displaybuffer[i]&0xFF)); Wire.write((uint8_t)(displaybuffer[i]>>8)); }
+  Wire.endTransmission();
+}
+void Adafruit_7segment::writeDigitNum(uint8_t d, uint8_t num, bool dot){
+  if(d>7 || num>9) return;
+  writeDigitRaw(d,numbertable[num]|(dot<<7));
+}
@@ -0,0 +1,125 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "hal.h"
+#include "halInternal.h"
+
+//The I2C bus, and the devices on it: HT16K33s (0x70-0x77) keep their display RAM and setup; the DS3231 (0x68) serves its registers
+//from hal.cpp's timekeeping; the VEML7700 (0x10) measures the lux set by halVEML7700Lux. Anything else takes writes and reads back zeroes. Every byte on the wire is counted, per address.
+
+TwoWire Wire;
+
+struct HalHT16K33 {
+  byte ram[16];
+  bool osc; //oscillator on
+  bool on; //display on
+  byte brightness;
+  unsigned long brightnessSets; //brightness commands received
+};
+HalHT16K33 halHT[8]; //per address 0x70-0x77
+
+unsigned long halI2CByteCount[128];
+unsigned long halI2CTxCount[128];
+unsigned long halI2CHz = 100000; //the Arduino default
+
+byte halI2CAddr = 0; //the transaction being written
+byte halI2CBuf[64]; byte halI2CLen = 0;
+byte halI2CPtr[128]; //per address, the register pointer, as set by the last write
+byte halI2CRead[32]; byte halI2CReadLen = 0; byte halI2CReadPos = 0; //per requestFrom
+
+void halI2CClear(){
+  memset(halI2CByteCount,0,sizeof(halI2CByteCount));
+  memset(halI2CTxCount,0,sizeof(halI2CTxCount));
+}
+unsigned long halI2CBytes(byte addr){ return addr<128? halI2CByteCount[addr]: 0; }
+unsigned long halI2CTransactions(byte addr){ return addr<128? halI2CTxCount[addr]: 0; }
+unsigned long halI2CClock(){ return halI2CHz; }
+
+bool halIsHT(byte addr){ return (addr&0xF8)==0x70; } //"private"
+word halHT16K33Row(byte addr, byte row){
+  if(!halIsHT(addr) || row>7) return 0;
+  HalHT16K33 &h = halHT[addr&7];
+  return h.ram[row*2]|(h.ram[row*2+1]<<8);
+}
+int halHT16K33Digit(byte addr, byte pos){
+  static const byte segs[10] = {0x3F,0x06,0x5B,0x4F,0x66,0x6D,0x7D,0x07,0x7F,0x6F}; //as Adafruit_7segment's numbertable
+  byte s = halHT16K33Row(addr,pos>=2? pos+1: pos)&0x7F; //without the decimal point
+  if(!s) return -1;
+  for(byte n=0; n<10; n++) if(segs[n]==s) return n;
+  return -2;
+}
+bool halHT16K33On(byte addr){ return halIsHT(addr) && halHT[addr&7].osc && halHT[addr&7].on; }
+byte halHT16K33Brightness(byte addr){ return halIsHT(addr)? halHT[addr&7].brightness: 0; }
+unsigned long halHT16K33BrightnessSets(byte addr){ return halIsHT(addr)? halHT[addr&7].brightnessSets: 0; }
+
+#define HAL_VEML_ADDR 0x10
+word halVEMLConf = 0x0001; //ALS_CONF (register 0) – shut down, until the sketch sets it
+double halVEMLLuxNow = 0; //per halVEML7700Lux
+void halVEML7700Lux(double lux){ halVEMLLuxNow = lux; }
+word halVEMLCount(){ //"private"
+  //The ALS output for the current lux, at the resolution ALS_CONF's gain and integration time give (per the datasheet, 0.0576 lux at x1, 100ms)
+  if(halVEMLConf&1) return 0; //shut down
+  static const double gains[4] = {1,2,0.125,0.25};
+  double it; //ms
+  switch((halVEMLConf>>6)&0x0F){
+    case 0x0C: it = 25; break;
+    case 0x08: it = 50; break;
+    case 0x01: it = 200; break;
+    case 0x02: it = 400; break;
+    case 0x03: it = 800; break;
+    default: it = 100; break;
+  }
+  double count = halVEMLLuxNow/(0.0576*100/it/gains[(halVEMLConf>>11)&3]);
+  return (count>65535? 65535: (word)count);
+}
+
+void TwoWire::begin(){}
+void TwoWire::setClock(unsigned long hz){ halI2CHz = hz; }
+void TwoWire::beginTransmission(uint8_t addr){ halI2CAddr = addr&0x7F; halI2CLen = 0; }
+size_t TwoWire::write(uint8_t b){
+  if(halI2CLen>=sizeof(halI2CBuf)) return 0;
+  halI2CBuf[halI2CLen++] = b;
+  return 1;
+}
+uint8_t TwoWire::endTransmission(bool stop){
+  byte a = halI2CAddr;
+  halI2CByteCount[a] += 1+halI2CLen; halI2CTxCount[a]++;
+  if(!halI2CLen) return 0;
+  if(halIsHT(a)){
+    //The first byte is a command: a RAM address (then data, auto-incrementing), system setup, display setup, or brightness
+    HalHT16K33 &h = halHT[a&7];
+    byte c = halI2CBuf[0];
+    switch(c&0xF0){
+      case 0x00: for(byte i=1; i<halI2CLen; i++) h.ram[(c+i-1)&0x0F] = halI2CBuf[i]; break;
+      case 0x20: h.osc = c&1; break;
+      case 0x80: h.on = c&1; break;
+      case 0xE0: h.brightness = c&0x0F; h.brightnessSets++; break;
+      default: break;
+    }
+    return 0;
+  }
+  //Register devices: the first byte sets the pointer, and any more are written from there
+  halI2CPtr[a] = halI2CBuf[0];
+  if(a==HAL_VEML_ADDR){ //16-bit registers, LSB first
+    if(halI2CLen>=3 && halI2CPtr[a]==0) halVEMLConf = halI2CBuf[1]|(halI2CBuf[2]<<8);
+    return 0;
+  }
+  for(byte i=1; i<halI2CLen; i++){
+    if(a==0x68) halRTCSetReg(halI2CPtr[a],halI2CBuf[i]);
+    halI2CPtr[a]++;
+  }
+  return 0;
+}
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len){
+  addr &= 0x7F;
+  if(len>sizeof(halI2CRead)) len = sizeof(halI2CRead);
+  halI2CByteCount[addr] += 1+len; halI2CTxCount[addr]++;
+  if(addr==HAL_VEML_ADDR){
+    word v = (halI2CPtr[addr]==0? halVEMLConf: halI2CPtr[addr]==4? halVEMLCount(): 0);
+    for(byte i=0; i<len; i++) halI2CRead[i] = (i==0? v&0xFF: i==1? v>>8: 0);
+  }
+  else for(byte i=0; i<len; i++) halI2CRead[i] = (addr==0x68? halRTCReg(halI2CPtr[addr]++): 0);
+  halI2CReadLen = len; halI2CReadPos = 0;
+  return len;
+}
+int TwoWire::available(){ return halI2CReadLen-halI2CReadPos; }
+int TwoWire::read(){ return halI2CReadPos<halI2CReadLen? halI2CRead[halI2CReadPos++]: -1; }
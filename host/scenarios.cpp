@@ -0,0 +1,522 @@
+//Scripted scenarios: the sketch run on the mock hardware, through presses, long runs and clock drift, checked against what
+//should have happened. Run one per process, by name – each starts from power-on. See host/README.md.
+
+#include "sim.h"
+#include "telemetry.h"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+int fails = 0;
+#define CHECK(cond, ...) do { if(!(cond)){ fails++; printf("FAIL line %d: %s – ",__LINE__,#cond); printf(__VA_ARGS__); printf("\n"); } } while(0)
+
+long durMs(){ return (long)timerTime[0]; } //the stopped timer's duration
+std::string shownChrono(long ms){
+  //What a stopped count-up timer of ms shows, under a minute (see updateDisplay): SSCC on 4 digits, else MMSSCC
+  char buf[24];
+  if(DISPLAY_SIZE<6) snprintf(buf,sizeof(buf),"%02ld%02ld",ms/1000,(ms%1000)/10);
+  else snprintf(buf,sizeof(buf),"%02ld%02ld%02ld",0L,ms/1000,(ms%1000)/10);
+  std::string s = buf;
+  return s;
+}
+std::string shownCountdown(long ms){
+  //What a stopped countdown of ms shows, under 100h (see updateDisplay): MMSS under an hour on 4 digits, else HHMM, or HHMMSS on 6
+  long sec = (ms+990)/1000; //rounded up, as shown
+  char buf[24];
+  if(DISPLAY_SIZE<6 && sec<3600) snprintf(buf,sizeof(buf),"%02ld%02ld",sec/60,sec%60);
+  else if(DISPLAY_SIZE<6) snprintf(buf,sizeof(buf),"%02ld%02ld",sec/3600,(sec/60)%60);
+  else snprintf(buf,sizeof(buf),"%02ld%02ld%02ld",sec/3600,(sec/60)%60,sec%60);
+  std::string s = buf;
+  return s;
+}
+
+#if TELEMETRY_LEVEL
+struct TelemFrame { byte type; byte arg; unsigned long val; };
+std::vector<TelemFrame> telemFrames(unsigned long *junk=0){ //"private"
+  //Decodes everything sent over Serial as tools/telemetry_decode.py does: sync, type, arg, val (little-endian), checksum.
+  //Bytes that aren't part of a valid frame are skipped, and counted in junk.
+  std::vector<TelemFrame> frames;
+  const byte *d = halSerialData(); size_t len = halSerialLen();
+  if(junk) *junk = 0;
+  for(size_t i=0; i<len; ){
+    byte sum = 0;
+    if(i+8<=len && d[i]==0xA5){ for(byte k=1; k<7; k++) sum += d[i+k]; }
+    if(i+8>len || d[i]!=0xA5 || sum!=d[i+7]){ i++; if(junk) (*junk)++; continue; }
+    TelemFrame f; f.type = d[i+1]; f.arg = d[i+2];
+    f.val = d[i+3]|(d[i+4]<<8)|(d[i+5]<<16)|((unsigned long)d[i+6]<<24);
+    frames.push_back(f);
+    i += 8;
+  }
+  return frames;
+}
+unsigned long telemCount(byte type){ //"private"
+  //How many records of type have been sent over telemetry
+  unsigned long n = 0;
+  for(TelemFrame &f: telemFrames()) if(f.type==type) n++;
+  return n;
+}
+#endif
+
+void scnBounce(){
+  //Sel starts the timer when pressed and stops it when released, timed from the edges – however they bounce
+  simBoot();
+  //A glitch between polls is noise, not a press
+  simPulse(CTRL_SEL,50);
+  simRun(30000);
+  CHECK(!timerRunning,"a 50µs glitch started the timer");
+  //A bouncing press, held for a second, then a bouncing release
+  unsigned long long press = simSet(CTRL_SEL,1,5);
+  simRun(1000000-(halMicros()-press));
+  CHECK(bitRead(timerRunning,0),"the press didn't start the timer");
+  unsigned long long release = simSet(CTRL_SEL,0,5);
+  simRun(50000);
+  CHECK(!timerRunning,"the release didn't stop the timer");
+  long el = (long)((release-press)/1000);
+  CHECK(labs(durMs()-el)<=1,"timed %ldms, pressed for %ldms",durMs(),el);
+  CHECK(simDisplay()==shownChrono(durMs()),"shows [%s] for %ldms",simDisplay().c_str(),durMs());
+  //Quick presses, each 100ms apart – a stop and restart can follow each other as fast as a finger can
+  for(byte k=0; k<3; k++){
+    simRun(100000);
+    press = simSet(CTRL_SEL,1,3);
+    simRun(100000-(halMicros()-press));
+    CHECK(bitRead(timerRunning,0),"quick press %d didn't start the timer",k);
+    release = simSet(CTRL_SEL,0,3);
+    simRun(20000);
+    CHECK(!timerRunning,"quick release %d didn't stop the timer",k);
+    el = (long)((release-press)/1000);
+    CHECK(labs(durMs()-el)<=1,"quick press %d timed %ldms, pressed for %ldms",k,durMs(),el);
+  }
+  CHECK(!getInputDropped(),"%d input events dropped",getInputDropped());
+  CHECK(!simBacksteps,"ms() went backward %lu times",simBacksteps);
+}
+
+void scnHundredHours(){
+  //Sel held for over 100 hours: the display goes M:S, then H:M, then D:H, and the timer keeps time throughout
+  simBoot();
+  unsigned long long press = simSet(CTRL_SEL,1);
+  #if defined(RTC_DS3231) && !defined(RTC_SQW_PIN)
+    //Polled, each second is seen up to a pass late, so the drift filter settles up to 2/2^24 off (0.12ppm, 43ms per 100h) rather than on it
+    const unsigned long step = 10000; const unsigned long long tol = 45+step/1000;
+  #else
+    const unsigned long step = 100000; const unsigned long long tol = 1; //a pass every 100ms is plenty, once the centiseconds are off the display
+  #endif
+  struct { unsigned long long at; const char *four; const char *six; } marks[] = {
+    {90*1000000ULL+50000,"0130","013005"}, //1:30.05 – M:S on 4 digits, M:S:C on 6
+    {(2*3600+3*60+30)*1000000ULL+50000,"0203","020330"}, //2:03:30 – H:M, H:M:S
+    {(99*3600+59*60+59)*1000000ULL+50000,"9959","995959"},
+    {(100*3600+30*60+30)*1000000ULL+50000,"0404","040430"}, //100:30:30 – D:H, D:H:M
+  };
+  unsigned long commits = 0; unsigned long bytes = 0;
+  for(byte k=0; k<sizeof(marks)/sizeof(marks[0]); k++){
+    if(k==2){
+      //For an hour of H:M, the display should be sent one frame per minute, and nothing in between
+      simRun(press+50*3600*1000000ULL-halMicros(),step);
+      halBusClear();
+      simRun(3600*1000000ULL,step);
+      #ifdef DISPLAY_HT16K33
+        commits = halI2CTransactions(DISPLAY_ADDR);
+      #else
+        commits = halSPILatches(); //a latch per changed row
+      #endif
+      bytes = simDisplayBytes();
+    }
+    simRun(press+marks[k].at-halMicros(),step);
+    const char *want = (DISPLAY_SIZE<6? marks[k].four: marks[k].six);
+    CHECK(simDisplay()==want,"at mark %d shows [%s], not [%s]",k,simDisplay().c_str(),want);
+  }
+  #ifdef DISPLAY_HT16K33
+    CHECK(commits>=59 && commits<=61,"%lu frames in an hour of H:M",commits);
+  #else
+    CHECK(commits>=59 && commits<=61*8,"%lu row latches in an hour of H:M",commits);
+  #endif
+  printf("an hour of H:M: %lu display bytes\n",bytes);
+  unsigned long long release = simSet(CTRL_SEL,0);
+  simRun(50000);
+  CHECK(!timerRunning,"the release didn't stop the timer");
+  unsigned long long el = (release-press)/1000;
+  CHECK(timerTime[0]+tol>=el && timerTime[0]<=el+tol,"timed %llums, held for %llums",timerTime[0],el);
+  CHECK(!simBacksteps,"ms() went backward %lu times",simBacksteps);
+}
+
+void scnFrameBytes(){
+  //The bus bytes each frame of the running chrono takes – only the digits that changed should be sent
+  simBoot();
+  halBusClear();
+  simSet(CTRL_SEL,1);
+  unsigned long frames = 0; unsigned long total = 0; unsigned long most = 0;
+  for(unsigned long long until=halMicros()+10000000ULL; halMicros()<until; ){ //10s of S:C, changing every 10ms
+    unsigned long was = simDisplayBytes();
+    simPass(100);
+    unsigned long n = simDisplayBytes()-was;
+    if(!n) continue;
+    frames++; total += n; if(n>most) most = n;
+  }
+  printf("%lu frames, %.2f bytes per frame on average, %lu at most\n",frames,(double)total/frames,most);
+  CHECK(frames>=995 && frames<=1005,"%lu frames in 10s of centiseconds",frames);
+  #ifdef DISPLAY_HT16K33
+    //Address, RAM address, then two bytes per row from the first changed digit to the last: mostly just the centiseconds
+    CHECK(most<=2+5*2,"a frame took %lu bytes",most);
+    CHECK(total<=frames*9/2,"%.2f bytes per frame",(double)total/frames);
+  #else
+    //A register and value per chip, per changed row – at most every row
+    CHECK(most<=8*NUM_MAX*2,"a frame took %lu bytes",most);
+  #endif
+}
+
+#ifdef RTC_DS3231
+void scnDriftStep(){
+  //The RTC runs fast, then slow, then gets set forward behind our back: ms() follows its rate, without ever stepping backward,
+  //and the chrono times by it. With SQW, each measurement is exact to the ms; polled, to within the poll.
+  #ifdef RTC_SQW_PIN
+    const long tolPpm = 10;
+  #else
+    const long tolPpm = 30;
+  #endif
+  const unsigned long step = 500;
+  halRTCSet(2026,1,1,12,0,0);
+  halRTCRate(50);
+  simBoot();
+  simRun(10*60*1000000ULL,step);
+  CHECK(labs(simPpm(millisRate)-50)<=tolPpm,"rate %ldppm, RTC runs at +50",simPpm(millisRate));
+  //The chrono, timed against the RTC
+  double rtc0 = halRTCElapsed();
+  simSet(CTRL_SEL,1);
+  simRun(10*60*1000000ULL,step);
+  simSet(CTRL_SEL,0);
+  double rtcEl = (halRTCElapsed()-rtc0)*1000;
+  simRun(50000,step);
+  CHECK(fabs(timerTime[0]-rtcEl)<=600.0*tolPpm/1000+1,"timed %llums over %.1fms of RTC time",timerTime[0],rtcEl);
+  printf("10min at +50ppm: timed %llums over %.1fms of RTC time\n",timerTime[0],rtcEl);
+  //A step in its rate, as from a change in temperature
+  halRTCRate(-80);
+  simRun(15*60*1000000ULL,step);
+  CHECK(labs(simPpm(millisRate)+80)<=tolPpm,"rate %ldppm, RTC runs at -80",simPpm(millisRate));
+  //A step in its time: the measurement it spoils is thrown out, rather than taken as drift
+  halRTCStep(17);
+  simRun(2*60*1000000ULL,step);
+  CHECK(labs(simPpm(millisRate)+80)<=tolPpm,"rate %ldppm after the RTC was set, RTC runs at -80",simPpm(millisRate));
+  CHECK(!simBacksteps,"ms() went backward %lu times",simBacksteps);
+  #if TELEMETRY_LEVEL>=2
+  CHECK(telemCount(TELEM_DRIFT)>=50,"%lu drift records sent",telemCount(TELEM_DRIFT));
+  #endif
+}
+#endif
+
+void scnLaps(){
+  //Alt, pressed while Sel holds the chrono running, records a lap – timed from its edge, and shown for a bit. Once stopped,
+  //taps of Alt page back through the laps, and a short hold switches between lap times and splits.
+  simBoot();
+  unsigned long long press = simSet(CTRL_SEL,1);
+  const unsigned long splitAt[3] = {1235,2880,3425}; //ms after the press – each lap is mid-centisecond, so edge rounding can't change what's shown
+  long lapMs[3]; long splitMs[3];
+  for(byte k=0; k<3; k++){
+    simRun(press+splitAt[k]*1000ULL-halMicros());
+    unsigned long long lap = simSet(CTRL_ALT,1,3);
+    splitMs[k] = (long)((lap-press)/1000); lapMs[k] = splitMs[k]-(k? splitMs[k-1]: 0);
+    simRun(30000);
+    CHECK(simDisplay()==shownChrono(lapMs[k]),"lap %d shows [%s], not its time of %ldms",k,simDisplay().c_str(),lapMs[k]);
+    simSet(CTRL_ALT,0,3);
+    simRun(100000);
+    CHECK(bitRead(timerRunning,0),"lap %d stopped the timer",k);
+  }
+  simRun(3000000); //past LAP_SHOW_DUR, back to the running chrono
+  CHECK(simDisplay()!=shownChrono(lapMs[2]),"still showing the last lap");
+  unsigned long long release = simSet(CTRL_SEL,0);
+  simRun(50000);
+  long total = (long)((release-press)/1000);
+  CHECK(labs(durMs()-total)<=1,"timed %ldms, pressed for %ldms",durMs(),total);
+  CHECK(simDisplay()==shownChrono(durMs()),"stopped, shows [%s] for %ldms",simDisplay().c_str(),durMs());
+  //Paging back: the latest lap, then the one before – then, with splits on, the split of that one and the one before, then the total
+  simTap(CTRL_ALT);
+  CHECK(simDisplay()==shownChrono(lapMs[2]),"first page shows [%s], not lap 2 of %ldms",simDisplay().c_str(),lapMs[2]);
+  simTap(CTRL_ALT);
+  CHECK(simDisplay()==shownChrono(lapMs[1]),"second page shows [%s], not lap 1 of %ldms",simDisplay().c_str(),lapMs[1]);
+  simTap(CTRL_ALT,1200000); //a short hold
+  CHECK(simDisplay()==shownChrono(splitMs[1]),"with splits, shows [%s], not split 1 of %ldms",simDisplay().c_str(),splitMs[1]);
+  simTap(CTRL_ALT);
+  CHECK(simDisplay()==shownChrono(splitMs[0]),"third page shows [%s], not split 0 of %ldms",simDisplay().c_str(),splitMs[0]);
+  simTap(CTRL_ALT);
+  CHECK(simDisplay()==shownChrono(durMs()),"past the oldest lap, shows [%s], not the total of %ldms",simDisplay().c_str(),durMs());
+  #if TELEMETRY_LEVEL
+    //Each lap is streamed, to the ms
+    byte n = 0;
+    for(TelemFrame &f: telemFrames()){
+      if(f.type!=TELEM_LAP) continue;
+      CHECK(n<3 && f.arg==n+1 && labs((long)f.val-lapMs[n])<=1,"lap record %d: lap %d of %lums",n,f.arg,f.val);
+      n++;
+    }
+    CHECK(n==3,"%d lap records sent",n);
+  #endif
+  CHECK(!getInputDropped(),"%d input events dropped",getInputDropped());
+}
+
+#ifdef PERSIST_STATE
+void scnPersistRestore(){
+  //A running chrono survives a power cut: it's checkpointed to the EEPROM ring when it starts, and restored per its RTC stamp,
+  //carrying on as though it had never stopped. A save cut short is passed over for the slot before it.
+  halRTCSet(2026,1,1,12,0,0);
+  simBoot();
+  unsigned long w0 = halEEPROMWrites();
+  unsigned long long press = simSet(CTRL_SEL,1);
+  simRun(3000000);
+  unsigned long perSave = halEEPROMWrites()-w0;
+  CHECK(perSave>0,"the start wasn't checkpointed");
+  simRun(3000000);
+  CHECK(halEEPROMWrites()-w0==perSave,"%lu EEPROM writes while running, after the start's %lu",halEEPROMWrites()-w0-perSave,perSave);
+  simPowerCut(5000000);
+  CHECK(bitRead(timerRunning,0),"the running chrono wasn't restored running");
+  simRun(1000000);
+  //Sel is still held, so its release stops it – timed from the press before the cut, to within the RTC's second (see timerRestore)
+  unsigned long long release = simSet(CTRL_SEL,0);
+  w0 = halEEPROMWrites();
+  while(halEEPROMWrites()-w0<5) simPass(100); //the stop's save, cut short a few bytes in
+  long el = (long)((release-press)/1000);
+  CHECK(!timerRunning,"the release didn't stop the timer");
+  CHECK(labs(durMs()-el)<=1000,"timed %ldms across the cut, held for %ldms",durMs(),el);
+  printf("across a 5s power cut: timed %ldms, held for %ldms\n",durMs(),el);
+  simPowerCut(2000000);
+  CHECK(bitRead(timerRunning,0),"the torn save wasn't passed over for the one before, which was running");
+  //Stopped again (on Sel's release), with the save left to finish: it's restored stopped, as it was
+  simTap(CTRL_SEL);
+  simRun(200000);
+  long dur = durMs();
+  simPowerCut(5000000);
+  CHECK(!timerRunning && bitRead(timerHeld,0),"the stopped chrono wasn't restored stopped");
+  CHECK(durMs()==dur,"restored %ldms, saved %ldms",durMs(),dur);
+  CHECK(simDisplay()==shownChrono(dur),"restored, shows [%s] for %ldms",simDisplay().c_str(),dur);
+}
+#endif
+
+#if TELEMETRY_LEVEL
+void scnTelemetryDecode(){
+  //Start, lap, stop and clear each stream a record, with the values the sketch has – and nothing else is sent but drift records
+  simBoot();
+  unsigned long long press = simSet(CTRL_SEL,1);
+  simRun(50000);
+  unsigned long long origin = timerTime[0]; //ms() at the start
+  simRun(1000000);
+  unsigned long long lap = simTap(CTRL_ALT);
+  simRun(500000);
+  simSet(CTRL_SEL,0);
+  simRun(50000);
+  unsigned long long dur = timerTime[0];
+  simRun((STOPWATCH_TIMEOUT+1)*1000000ULL); //cleared by the stopwatch timeout
+  unsigned long junk;
+  std::vector<TelemFrame> frames = telemFrames(&junk);
+  CHECK(!junk,"%lu bytes sent that aren't part of a valid record",junk);
+  struct { byte type; byte arg; unsigned long long val; long tol; } want[] = {
+    {TELEM_START,0,origin,0},
+    {TELEM_LAP,1,(lap-press)/1000,1},
+    {TELEM_STOP,0,dur,0},
+    {TELEM_CLEAR,0,0,0},
+  };
+  byte n = 0;
+  for(TelemFrame &f: frames){
+    if(f.type==TELEM_DRIFT) continue;
+    if(n>=sizeof(want)/sizeof(want[0])){ CHECK(0,"an extra record: type %d, arg %d, val %lu",f.type,f.arg,f.val); continue; }
+    CHECK(f.type==want[n].type && f.arg==want[n].arg && labs((long)(f.val-(unsigned long)want[n].val))<=want[n].tol,
+      "record %d is type %d, arg %d, val %lu – not type %d, arg %d, val %llu",n,f.type,f.arg,f.val,want[n].type,want[n].arg,want[n].val);
+    n++;
+  }
+  CHECK(n==sizeof(want)/sizeof(want[0]),"%d timer records sent",n);
+}
+#endif
+
+#if SIM_CHANNELS>1
+void scnMultiChannel(){
+  //Sel, Alt, Up and Dn each start and stop their own channel, and show it – while the others carry on
+  simBoot();
+  unsigned long long start[4]; unsigned long long stop[4];
+  start[0] = simTap(CTRL_SEL);
+  CHECK(timerRunning==0b0001 && timerCh==0,"Sel: running %x, showing %d",timerRunning,timerCh);
+  simRun(300000);
+  start[2] = simTap(CTRL_UP);
+  CHECK(timerRunning==0b0101 && timerCh==2,"Up: running %x, showing %d",timerRunning,timerCh);
+  simRun(300000);
+  //Alt pressed while Dn is held: a chord only sends Alt's press, which is all its channel needs
+  start[3] = simSet(CTRL_DN,1); simRun(200000);
+  start[1] = simSet(CTRL_ALT,1); simRun(100000);
+  simSet(CTRL_ALT,0); simRun(100000);
+  simSet(CTRL_DN,0); simRun(50000);
+  CHECK(timerRunning==0b1111 && timerCh==1,"Dn then Alt: running %x, showing %d",timerRunning,timerCh);
+  simRun(500000);
+  stop[0] = simTap(CTRL_SEL);
+  simRun(400000);
+  stop[2] = simTap(CTRL_UP);
+  CHECK(timerRunning==0b1010 && timerCh==2,"Sel, Up stopped: running %x, showing %d",timerRunning,timerCh);
+  CHECK(simDisplay()==shownChrono((long)timerTime[2]),"shows [%s] for channel 2's %llums",simDisplay().c_str(),timerTime[2]);
+  unsigned long long held0 = timerTime[0];
+  simRun(700000);
+  stop[1] = simTap(CTRL_ALT);
+  stop[3] = simTap(CTRL_DN);
+  CHECK(!timerRunning && timerCh==3,"all stopped: running %x, showing %d",timerRunning,timerCh);
+  CHECK(timerTime[0]==held0,"stopped channel 0 went from %llums to %llums",held0,timerTime[0]);
+  for(byte c=0; c<4; c++){
+    long el = (long)((stop[c]-start[c])/1000);
+    long tol = (c<2? 1: 2); //Sel/Alt are timed from their edges, Up/Dn when polled
+    CHECK(labs((long)timerTime[c]-el)<=tol,"channel %d timed %llums, between presses %ldms apart",c,timerTime[c],el);
+  }
+  CHECK(simDisplay()==shownChrono((long)timerTime[3]),"shows [%s] for channel 3's %llums",simDisplay().c_str(),timerTime[3]);
+}
+#endif
+
+#if defined(TIMER_COUNTDOWN) && defined(PIEZO_PIN)
+void scnCountdownSignal(){
+  //A countdown, held running on Sel: at zero the piezo starts within a ms of the deadline, and beeps each second after,
+  //until a press silences it. Set to start over, it beeps once at each zero, each deadline following on from the last.
+  simBoot();
+  CHECK(simDisplay()==shownCountdown(TIMER_COUNTDOWN*1000L),"shows [%s] before starting",simDisplay().c_str());
+  unsigned long long press = simSet(CTRL_SEL,1);
+  unsigned long long deadline = press+TIMER_COUNTDOWN*1000000ULL;
+  simRun(deadline-2000-halMicros());
+  CHECK(!halTone(PIEZO_PIN),"beeping before the deadline");
+  unsigned long long on = 0;
+  while(!on && halMicros()<deadline+100000){ simPass(50); if(halTone(PIEZO_PIN)) on = halMicros(); }
+  CHECK(on && on+1000>=deadline && on<=deadline+1000,"the signal started %lldµs from the deadline",on? (long long)(on-deadline): -1LL);
+  printf("the signal started %lldµs from the deadline\n",(long long)(on-deadline));
+  simRun(20000);
+  CHECK(!timerRunning,"still running after zero");
+  CHECK(simDisplay()==shownCountdown(0),"at zero, shows [%s]",simDisplay().c_str());
+  //A beep in the first half of each second
+  simRun(deadline+700000-halMicros());
+  CHECK(!halTone(PIEZO_PIN),"still beeping 700ms after the deadline");
+  simRun(deadline+1100000-halMicros());
+  CHECK(halTone(PIEZO_PIN),"no second beep");
+  //Releasing Sel leaves it going – a press silences it, and starts the countdown again
+  simSet(CTRL_SEL,0);
+  simRun(deadline+2100000-halMicros());
+  CHECK(halTone(PIEZO_PIN),"the release silenced it");
+  press = simSet(CTRL_SEL,1);
+  simRun(20000);
+  CHECK(!halTone(PIEZO_PIN),"the press didn't silence it");
+  CHECK(bitRead(timerRunning,0),"the press didn't start it again");
+  simRun(1000000);
+  unsigned long long release = simSet(CTRL_SEL,0);
+  simRun(20000);
+  long left = TIMER_COUNTDOWN*1000L-(long)((release-press)/1000);
+  CHECK(labs(durMs()-left)<=1,"stopped with %ldms left, not %ldms",durMs(),left);
+  //Start over (timerState bit 2)
+  timerClear(0); timerState[0] |= 4;
+  press = simSet(CTRL_SEL,1);
+  simRun(20000);
+  unsigned long long target = timerTime[0];
+  deadline = press+TIMER_COUNTDOWN*1000000ULL;
+  simRun(deadline+20000-halMicros());
+  CHECK(halTone(PIEZO_PIN),"no beep at zero, starting over");
+  CHECK(bitRead(timerRunning,0),"stopped at zero, rather than starting over");
+  CHECK(timerTime[0]==target+TIMER_COUNTDOWN*1000ULL,"the next deadline is %lldms from the last, not %dms",(long long)(timerTime[0]-target),TIMER_COUNTDOWN*1000);
+  simRun(deadline+1100000-halMicros());
+  CHECK(!halTone(PIEZO_PIN),"more than one beep, starting over");
+  simRun(deadline+TIMER_COUNTDOWN*1000000ULL+20000-halMicros());
+  CHECK(halTone(PIEZO_PIN),"no beep at the second zero");
+  simSet(CTRL_SEL,0);
+  simRun(50000);
+}
+#endif
+
+#ifdef INPUT_UPDN_ROTARY
+void scnRotaryBatch(){
+  //Turning the encoder sets the countdown's duration while it's stopped: slowly, a step per detent; quickly, the detents are gathered
+  //into an event per batch, each scaled up with the speed – so a fast spin is a few events and redraws, not one per detent.
+  simBoot();
+  unsigned long dur0 = timerDur[0];
+  simTurn(3,300000,2); //a detent every 300ms, with contact bounce
+  simRun(100000);
+  CHECK(timerDur[0]==dur0+3000,"3 slow detents from %lums made %lums",dur0,timerDur[0]);
+  CHECK(simDisplay()==shownCountdown(timerDur[0]),"shows [%s] for %lums",simDisplay().c_str(),timerDur[0]);
+  //Fast: 40 detents in 200ms
+  halBusClear();
+  simTurn(40,5000);
+  simRun(100000);
+  unsigned long frames = halI2CTransactions(DISPLAY_ADDR);
+  printf("40 detents in 200ms: %lums, in %lu display frames\n",timerDur[0],frames);
+  CHECK(frames<=6,"%lu display frames for a 200ms spin",frames);
+  CHECK(timerDur[0]>dur0+3000+40*1000UL,"40 fast detents only made %lums – no faster than turning slowly",timerDur[0]);
+  CHECK(simDisplay()==shownCountdown(timerDur[0]),"shows [%s] for %lums",simDisplay().c_str(),timerDur[0]);
+  //All the way down: at zero, it counts up instead
+  simTurn(-250,2000);
+  simRun(100000);
+  CHECK(timerDur[0]==0 && ((timerState[0]>>1)&1),"spun down to %lums, state %x",timerDur[0],timerState[0]);
+  CHECK(simDisplay()==shownChrono(0),"counting up, shows [%s]",simDisplay().c_str());
+  simTurn(2,300000);
+  simRun(100000);
+  CHECK(timerDur[0]==2000,"2 slow detents from zero made %lums",timerDur[0]);
+  //While it's running, the encoder leaves it alone
+  simSet(CTRL_SEL,1);
+  simTurn(3,300000);
+  CHECK(timerDur[0]==2000,"turning while running made %lums",timerDur[0]);
+  simSet(CTRL_SEL,0);
+  simRun(50000);
+  CHECK(!getInputDropped(),"%d input events dropped",getInputDropped());
+}
+#endif
+
+#ifdef LIGHTSENSOR_VEML7700
+void scnLightHysteresis(){
+  //The VEML7700 is read once per measurement, smoothed, and stepped into display brightness with hysteresis: lux noise about a
+  //step's edge doesn't reach the display, but a real change in the room does, in a write or two.
+  halVEML7700Lux(200); //step 7 of 15, per LUX_DIM 30 and LUX_FULL 400
+  simBoot();
+  halBusClear();
+  simRun(11000000ULL);
+  unsigned long reads = halI2CTransactions(0x10)/2; //the register pointer, then the reading
+  CHECK(reads>=9 && reads<=11,"%lu readings in 11s",reads);
+  CHECK(halHT16K33Brightness(DISPLAY_ADDR)==7,"brightness %d at 200 lux",halHT16K33Brightness(DISPLAY_ADDR));
+  //Noise of 10 lux either side of 215, the edge between steps 7 and 8
+  unsigned long sets = halHT16K33BrightnessSets(DISPLAY_ADDR);
+  for(byte k=0; k<60; k++){ halVEML7700Lux(k&1? 225: 205); simRun(1100000); }
+  CHECK(halHT16K33BrightnessSets(DISPLAY_ADDR)==sets,"%lu brightness writes from a minute of noise",halHT16K33BrightnessSets(DISPLAY_ADDR)-sets);
+  CHECK(halHT16K33Brightness(DISPLAY_ADDR)==7,"brightness %d after the noise",halHT16K33Brightness(DISPLAY_ADDR));
+  //The room gets bright, then dark
+  halVEML7700Lux(1000);
+  simRun(10000000ULL);
+  CHECK(halHT16K33Brightness(DISPLAY_ADDR)==BRIGHTNESS_FULL,"brightness %d at 1000 lux",halHT16K33Brightness(DISPLAY_ADDR));
+  CHECK(halHT16K33BrightnessSets(DISPLAY_ADDR)-sets<=2,"%lu brightness writes going to full",halHT16K33BrightnessSets(DISPLAY_ADDR)-sets);
+  halVEML7700Lux(5);
+  simRun(20000000ULL);
+  CHECK(halHT16K33Brightness(DISPLAY_ADDR)==BRIGHTNESS_DIM,"brightness %d at 5 lux",halHT16K33Brightness(DISPLAY_ADDR));
+  printf("%lu brightness writes in all\n",halHT16K33BrightnessSets(DISPLAY_ADDR));
+}
+#endif
+
+struct Scenario { const char *name; void (*run)(); };
+Scenario scenarios[] = {
+  {"bounce",scnBounce},
+  {"hundred_hours",scnHundredHours},
+  {"frame_bytes",scnFrameBytes},
+  #ifdef RTC_DS3231
+  {"drift_step",scnDriftStep},
+  #endif
+  {"laps",scnLaps},
+  #ifdef PERSIST_STATE
+  {"persist_restore",scnPersistRestore},
+  #endif
+  #if TELEMETRY_LEVEL
+  {"telemetry_decode",scnTelemetryDecode},
+  #endif
+  #if SIM_CHANNELS>1
+  {"multi_channel",scnMultiChannel},
+  #endif
+  #if defined(TIMER_COUNTDOWN) && defined(PIEZO_PIN)
+  {"countdown_signal",scnCountdownSignal},
+  #endif
+  #ifdef INPUT_UPDN_ROTARY
+  {"rotary_batch",scnRotaryBatch},
+  #endif
+  #ifdef LIGHTSENSOR_VEML7700
+  {"light_hysteresis",scnLightHysteresis},
+  #endif
+};
+
+int main(int argc, char **argv){
+  for(Scenario &s: scenarios){
+    if(argc<2 || strcmp(argv[1],s.name)) continue;
+    s.run();
+    printf("%s: %s\n",s.name,fails? "FAILED": "passed");
+    return fails? 1: 0;
+  }
+  printf("usage: %s <scenario>, one of:",argv[0]);
+  for(Scenario &s: scenarios) printf(" %s",s.name);
+  printf("\n");
+  return 2;
+}
@@ -0,0 +1,118 @@
+#include "sim.h"
+
+unsigned long simBacksteps = 0;
+unsigned long long simMsLast = 0; //ms(), as of the last pass of simRun
+
+void simBoot(){
+  #ifdef DISPLAY_MAX7219
+    halMAX7219Attach(CS_PIN,NUM_MAX);
+  #endif
+  #ifdef RTC_SQW_PIN
+    halRTCConnectSQW(RTC_SQW_PIN);
+  #endif
+  setup();
+  simMsLast = ms();
+  simRun(200000UL); //past INPUT_SETTLE_DUR
+}
+void simRun(unsigned long long us, unsigned long step){
+  unsigned long long until = halMicros()+us;
+  while(halMicros()<until) simPass(until-halMicros()<step? until-halMicros(): step);
+}
+void simPass(unsigned long step){
+  loop();
+  unsigned long long m = ms();
+  if(m<simMsLast) simBacksteps++;
+  simMsLast = m;
+  halAdvance(step);
+}
+unsigned long long simSet(byte pin, bool pressed, byte bounces, unsigned long bounceUs){
+  bool level = !pressed; //low when pressed
+  unsigned long long first = halMicros();
+  for(byte k=0; k<bounces; k++){ //each bounce is a change to the new level and back
+    halSetPin(pin,level); simRun(bounceUs/2,bounceUs/4+1);
+    halSetPin(pin,!level); simRun(bounceUs/2,bounceUs/4+1);
+  }
+  halSetPin(pin,level);
+  return first;
+}
+unsigned long long simPulse(byte pin, unsigned long us){
+  //Lines up with the middle of a ms, so it falls between the input task's polls (every TASK_INPUT_MS)
+  simRun(1000-halMicros()%1000+400);
+  unsigned long long at = halMicros();
+  halSetPin(pin,0); halAdvance(us); halSetPin(pin,1);
+  return at;
+}
+unsigned long long simTap(byte pin, unsigned long us){
+  unsigned long long at = simSet(pin,1);
+  simRun(us);
+  simSet(pin,0);
+  simRun(50000);
+  return at;
+}
+#ifdef INPUT_UPDN_ROTARY
+void simTurn(int detents, unsigned long usPerDetent, byte bounces){
+  //Each detent is four quadrature states, per state = B<<1|A (1 = low): up goes 0,1,3,2,0, down the other way. A is CTRL_UP, B is CTRL_DN (see rotISR).
+  static const byte up[4] = {1,3,2,0}; static const byte dn[4] = {2,3,1,0};
+  byte st = 0; //resting, both high
+  for(int k=0; k<(detents<0? -detents: detents); k++){
+    for(byte s=0; s<4; s++){
+      byte next = (detents>0? up[s]: dn[s]);
+      byte pin = ((st^next)&1? CTRL_UP: CTRL_DN); //the one pin that changes
+      bool level = !(next&(pin==CTRL_UP? 1: 2));
+      for(byte b=0; b<bounces; b++){ halSetPin(pin,level); halAdvance(20); halSetPin(pin,!level); halAdvance(20); }
+      halSetPin(pin,level);
+      st = next;
+      simRun(usPerDetent/4,usPerDetent/4<100? usPerDetent/4: 100);
+    }
+  }
+}
+#endif
+#ifdef PERSIST_STATE
+extern int persistPos; //see persist.cpp
+extern bool timerDirty;
+void simPowerCut(unsigned long offUs){
+  //Any save in progress is cut short, and the timer tables are lost – then timerRestore brings them back from EEPROM and the RTC, as at setup
+  halAdvance(offUs);
+  persistPos = -1; timerDirty = 0;
+  timerRunning = 0; timerHeld = 0;
+  for(byte c=0; c<SIM_CHANNELS; c++){ timerState[c] = 0; timerTime[c] = 0; timerDur[c] = 0; }
+  timerRestore();
+  updateDisplay();
+}
+#endif
+std::string simDisplay(){
+  std::string s;
+  for(byte i=0; i<DISPLAY_SIZE; i++){
+    int d = -2;
+    #ifdef DISPLAY_HT16K33
+      d = halHT16K33Digit(DISPLAY_ADDR,i);
+    #endif
+    #ifdef DISPLAY_MAX7219
+      //Match the chips' row registers against each glyph, as dispMAX7219.cpp draws them
+      byte chip = digitChip[i]; byte mLo = digitMask[i][0]; byte mHi = digitMask[i][1];
+      bool blank = 1;
+      for(byte r=0; r<8; r++) if((halMAX7219Reg(chip,r+1)&mLo) || (mHi && (halMAX7219Reg(chip+1,r+1)&mHi))) blank = 0;
+      if(blank) d = -1;
+      for(byte n=0; n<10 && d==-2; n++){
+        bool match = 1;
+        for(byte r=0; r<8 && match; r++){
+          if((halMAX7219Reg(chip,r+1)&mLo)!=glyphSlices[i][n][r][0]) match = 0;
+          if(mHi && (halMAX7219Reg(chip+1,r+1)&mHi)!=glyphSlices[i][n][r][1]) match = 0;
+        }
+        if(match) d = n;
+      }
+    #endif
+    s += (d>=0? (char)('0'+d): d==-1? ' ': '?');
+  }
+  return s;
+}
+unsigned long simDisplayBytes(){
+  #ifdef DISPLAY_HT16K33
+    return halI2CBytes(DISPLAY_ADDR);
+  #else
+    return halSPIBytes();
+  #endif
+}
+long simPpm(long rate){
+  return (long)((long long)rate*1000000/0x1000000);
+}
@@ -0,0 +1,50 @@
+#ifndef SIM_H
+#define SIM_H
+
+//Driving the sketch on the mock hardware, for the scenarios and benchmarks – compiled per host config, like the sketch
+
+#include <Arduino.h>
+#include "arduino-clock.h"
+#include "dispFrame.h"
+#include "input.h"
+#include "rtcDS3231.h"
+#include "rtcMillis.h"
+#include "dispMAX7219.h"
+#include "hal.h"
+#include <string>
+
+//Sketch state the scenarios look at (see arduino-clock.ino)
+#ifdef TIMER_CHANNELS
+#define SIM_CHANNELS TIMER_CHANNELS
+#else
+#define SIM_CHANNELS 1 //per arduino-clock.ino's default
+#endif
+extern word timerRunning;
+extern word timerHeld;
+extern byte timerState[];
+extern unsigned long long timerTime[];
+extern unsigned long timerDur[];
+#if SIM_CHANNELS>1
+extern byte timerCh;
+#endif
+extern long millisRate;
+
+extern unsigned long simBacksteps; //how many times ms() has been seen to go backward, per simRun
+
+void simBoot(); //setup(), then runs until the inputs have settled
+void simPass(unsigned long step); //runs loop() once, then advances the clock by step µs
+void simRun(unsigned long long us, unsigned long step=100); //runs loop(), advancing the clock by step µs after each pass, for us
+unsigned long long simSet(byte pin, bool pressed, byte bounces=0, unsigned long bounceUs=200); //drives a button (low when pressed), bouncing first – returns when it first changed, µs
+unsigned long long simPulse(byte pin, unsigned long us); //a glitch: pressed for us, between polls – returns when, µs
+unsigned long long simTap(byte pin, unsigned long us=100000); //presses pin for us, then releases it and runs 50ms more – returns when it was pressed, µs
+#ifdef INPUT_UPDN_ROTARY
+void simTurn(int detents, unsigned long usPerDetent, byte bounces=0); //turns the encoder (positive for up), each state change bouncing first
+#endif
+#ifdef PERSIST_STATE
+void simPowerCut(unsigned long offUs); //the timer state is lost for offUs, then restored as at setup – the rest of the sketch carries on
+#endif
+std::string simDisplay(); //the digits shown: 0-9, ' ' if blank, '?' if anything else
+unsigned long simDisplayBytes(); //bytes sent to the display, on whichever bus it's on, including setup
+long simPpm(long rate); //a millisRate, in ppm
+
+#endif //SIM_H
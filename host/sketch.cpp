@@ -0,0 +1,3 @@
+//The sketch itself, compiled as C++ for the host build (its prototypes are all in arduino-clock.h, so it needs no preprocessing)
+
+#include "arduino-clock.ino"
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Decodes the binary telemetry stream from arduino-clock (see arduino-clock/telemetry.cpp).
+
+Each record is 8 bytes: sync (0xA5), type, arg, val (uint32, little-endian), checksum
+(sum of type, arg and val bytes, mod 256). Anything else in the stream (e.g. SHOW_SERIAL text)
+is skipped until the next valid record.
+
+Usage:
+  telemetry_decode.py capture.bin             decode a captured file
+  telemetry_decode.py /dev/ttyUSB0 -b 115200  decode live from a serial port (needs pyserial)
+  telemetry_decode.py -                       decode from stdin
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+TYPES = {
+    1: "start",
+    2: "stop",
+    3: "clear",
+    4: "lap",
+    5: "drift",
+    6: "dropped",
+    7: "lost",
+    8: "prof",
+    9: "prof_hist",
+    10: "runout",
+}
+PROF_FIELDS = ("samples", "min", "max", "mean")
+
+
+def describe(rtype, arg, val):
+    if rtype == 1:
+        return "start  ch=%d at=%dms" % (arg, val)
+    if rtype == 2:
+        return "stop   ch=%d duration=%s" % (arg, fmt_ms(val))
+    if rtype == 3:
+        return "clear  ch=%d" % arg
+    if rtype == 4:
+        return "lap    #%d lap=%s" % (arg, fmt_ms(val))
+    if rtype == 5:
+        rate = struct.unpack("<i", struct.pack("<I", val))[0]
+        return "drift  rate=%d (%.3fppm)" % (rate, rate * 1e6 / (1 << 24))
+    if rtype == 6:
+        return "dropped input events=%d" % val
+    if rtype == 7:
+        return "lost   telemetry records=%d" % val
+    if rtype == 8:
+        field = PROF_FIELDS[arg & 15] if (arg & 15) < 4 else "field%d" % (arg & 15)
+        unit = "" if field == "samples" else ("B" if arg >> 4 == 11 else "us")
+        return "prof   %s %s=%d%s" % (stage_name(arg >> 4), field, val, unit)
+    if rtype == 9:
+        b = arg & 15
+        unit = "B" if arg >> 4 == 11 else "us"
+        rng = "0" if b == 0 else "%d-%d" % (1 << (b - 1), (1 << b) - 1)
+        if b == 15:
+            rng = ">=%d" % (1 << 14)
+        rng += unit
+        return "prof   %s hist[%s]=%d" % (stage_name(arg >> 4), rng, val)
+    if rtype == 10:
+        return "runout ch=%d at=%dms" % (arg, val)
+    return "type %d arg=%d val=%d" % (rtype, arg, val)
+
+
+def stage_name(stage):
+    # Per the task table in arduino-clock.ino; which optional tasks are present depends on the config
+    names = ("input", "timer", "rtc", "display")
+    if stage == 10:
+        return "press-latency"
+    if stage == 11:
+        return "bus-bytes"
+    return names[stage] if stage < len(names) else "task%d" % stage
+
+
+def fmt_ms(ms):
+    s, ms = divmod(ms, 1000)
+    m, s = divmod(s, 60)
+    h, m = divmod(m, 60)
+    return "%d:%02d:%02d.%03d" % (h, m, s, ms)
+
+
+def decode(read):
+    """Yields (type, arg, val) per valid record, from read(n) -> bytes."""
+    buf = bytearray()
+    while True:
+        chunk = read(64)
+        if not chunk:
+            return
+        buf += chunk
+        while len(buf) >= 8:
+            if buf[0] != SYNC:
+                del buf[0]
+                continue
+            if sum(buf[1:7]) & 0xFF != buf[7]:
+                del buf[0]  # not a record after all – resync
+                continue
+            rtype, arg, val = struct.unpack("<BBI", bytes(buf[1:7]))
+            del buf[:8]
+            yield rtype, arg, val
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("source", help="capture file, serial port, or - for stdin")
+    ap.add_argument("-b", "--baud", type=int, default=115200, help="serial baud rate (per TELEMETRY_BAUD)")
+    args = ap.parse_args()
+
+    if args.source == "-":
+        stream = sys.stdin.buffer
+        read = stream.read
+    elif args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        import serial  # pyserial
+
+        stream = serial.Serial(args.source, args.baud, timeout=None)
+        read = lambda n: stream.read(1) + stream.read(stream.in_waiting)
+    else:
+        stream = open(args.source, "rb")
+        read = stream.read
+
+    try:
+        for rtype, arg, val in decode(read):
+            print(describe(rtype, arg, val), flush=True)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()